@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_DestinationSampler.h"
+#include "AI_NavGraph.h"
+
+void FAI_DestinationSampler::Build(const FAI_NavGraph& Graph, const TArray<float>& Weights)
+{
+	const int32 NodeCount = Graph.NumNodes();
+
+	if (Graph.LayoutVersion != LayoutVersion)
+	{
+		LastPickedTimes.Reset();
+		LayoutVersion = Graph.LayoutVersion;
+	}
+	const int32 NumPickTimes = LastPickedTimes.Num();
+	LastPickedTimes.SetNum(NodeCount);
+	for (int32 Node = NumPickTimes; Node < NodeCount; Node++)
+	{
+		LastPickedTimes[Node] = -UE_BIG_NUMBER;
+	}
+
+	const int32 NumComponents = Graph.Components.NumWeakComponents();
+
+	// Count the nodes of every weak component, then place them like a counting sort.
+	ComponentOffsets.Init(0, NumComponents + 1);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		if (CanPick(Graph, Weights, Node))
+		{
+			ComponentOffsets[Graph.Components.GetWeakComponent(Node) + 1]++;
+		}
+	}
+	for (int32 Component = 0; Component < NumComponents; Component++)
+	{
+		ComponentOffsets[Component + 1] += ComponentOffsets[Component];
+	}
+
+	TArray<int32> NextEntries(ComponentOffsets.GetData(), NumComponents);
+	TArray<float> EntryWeights;
+	Nodes.SetNumUninitialized(ComponentOffsets[NumComponents]);
+	EntryWeights.SetNumUninitialized(Nodes.Num());
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		if (CanPick(Graph, Weights, Node))
+		{
+			const int32 Entry = NextEntries[Graph.Components.GetWeakComponent(Node)]++;
+			Nodes[Entry] = Node;
+			EntryWeights[Entry] = Weights[Node];
+		}
+	}
+
+	Probabilities.SetNumUninitialized(Nodes.Num());
+	Aliases.SetNumUninitialized(Nodes.Num());
+	for (int32 Component = 0; Component < NumComponents; Component++)
+	{
+		BuildAliasTable(ComponentOffsets[Component], ComponentOffsets[Component + 1], EntryWeights);
+	}
+}
+
+// The weights of a node never change while the nodes keep their indices, so only which nodes can be picked and where they are grouped is checked.
+bool FAI_DestinationSampler::IsUpToDate(const FAI_NavGraph& Graph, const TArray<float>& Weights) const
+{
+	const int32 NumComponents = Graph.Components.NumWeakComponents();
+	if (Graph.LayoutVersion != LayoutVersion || ComponentOffsets.Num() != NumComponents + 1)
+	{
+		return false;
+	}
+
+	int32 NumPickable = 0;
+	for (int32 Node = 0; Node < Graph.NumNodes(); Node++)
+	{
+		if (CanPick(Graph, Weights, Node))
+		{
+			NumPickable++;
+		}
+	}
+	if (NumPickable != Nodes.Num())
+	{
+		return false;
+	}
+
+	// Every node in the tables can still be picked and the counts match, so no other node can be picked.
+	for (int32 Component = 0; Component < NumComponents; Component++)
+	{
+		for (int32 Entry = ComponentOffsets[Component]; Entry < ComponentOffsets[Component + 1]; Entry++)
+		{
+			if (!CanPick(Graph, Weights, Nodes[Entry]) || Graph.Components.GetWeakComponent(Nodes[Entry]) != Component)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool FAI_DestinationSampler::CanPick(const FAI_NavGraph& Graph, const TArray<float>& Weights, int32 Node)
+{
+	return Graph.Components.NumWeakComponents() > 0 && !Graph.IsNodeRemoved(Node) && Weights.IsValidIndex(Node) && Weights[Node] > 0.0f;
+}
+
+// Vose's method: the weights are scaled so that they average one, then every entry below one is topped up by an entry above one,
+// which becomes its alias. Each entry ends up covering exactly one slot, so a draw is one random slot and one coin flip.
+void FAI_DestinationSampler::BuildAliasTable(int32 First, int32 Last, TArray<float>& Weights)
+{
+	double TotalWeight = 0.0;
+	for (int32 Entry = First; Entry < Last; Entry++)
+	{
+		TotalWeight += Weights[Entry];
+	}
+
+	TArray<int32> Small;
+	TArray<int32> Large;
+	for (int32 Entry = First; Entry < Last; Entry++)
+	{
+		Weights[Entry] = float(Weights[Entry] * (Last - First) / TotalWeight);
+		(Weights[Entry] < 1.0f ? Small : Large).Add(Entry);
+	}
+
+	while (!Small.IsEmpty() && !Large.IsEmpty())
+	{
+		const int32 SmallEntry = Small.Pop(false);
+		const int32 LargeEntry = Large.Pop(false);
+		Probabilities[SmallEntry] = Weights[SmallEntry];
+		Aliases[SmallEntry] = LargeEntry;
+
+		Weights[LargeEntry] -= 1.0f - Weights[SmallEntry];
+		(Weights[LargeEntry] < 1.0f ? Small : Large).Add(LargeEntry);
+	}
+
+	// Whatever is left is one up to rounding errors.
+	for (const int32 Entry : Small)
+	{
+		Probabilities[Entry] = 1.0f;
+		Aliases[Entry] = Entry;
+	}
+	for (const int32 Entry : Large)
+	{
+		Probabilities[Entry] = 1.0f;
+		Aliases[Entry] = Entry;
+	}
+}
+
+void FAI_DestinationSampler::Empty()
+{
+	Nodes.Empty();
+	ComponentOffsets.Empty();
+	Probabilities.Empty();
+	Aliases.Empty();
+	LastPickedTimes.Empty();
+	LayoutVersion = 0;
+}
+
+int32 FAI_DestinationSampler::Sample(int32 WeakComponent) const
+{
+	if (!ComponentOffsets.IsValidIndex(WeakComponent + 1))
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 First = ComponentOffsets[WeakComponent];
+	const int32 Last = ComponentOffsets[WeakComponent + 1];
+	if (First == Last)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 Entry = FMath::RandRange(First, Last - 1);
+	return Nodes[FMath::FRand() < Probabilities[Entry] ? Entry : Aliases[Entry]];
+}
+
+void FAI_DestinationSampler::MarkPicked(int32 Node, double Time)
+{
+	if (LastPickedTimes.IsValidIndex(Node))
+	{
+		LastPickedTimes[Node] = Time;
+	}
+}
+
+// The penalty fades out in a straight line, so a node becomes more likely again the longer it has not been picked.
+float FAI_DestinationSampler::GetRecencyFactor(int32 Node, double Time, float RecencySeconds, float Penalty) const
+{
+	if (!LastPickedTimes.IsValidIndex(Node) || RecencySeconds <= 0.0f)
+	{
+		return 1.0f;
+	}
+
+	const float Freshness = 1.0f - FMath::Clamp(float(Time - LastPickedTimes[Node]) / RecencySeconds, 0.0f, 1.0f);
+	return 1.0f - FMath::Clamp(Penalty, 0.0f, 1.0f) * Freshness;
+}
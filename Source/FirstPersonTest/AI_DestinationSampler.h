@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+
+// Picks random destinations for roaming agents in constant time, each node as likely as its weight.
+// An alias table is built for each weakly connected part of the graph whenever the nodes that can be picked change, so a destination
+// is only ever drawn from the part of the graph the agent is in. It also remembers when each node was last picked.
+class FIRSTPERSONTEST_API FAI_DestinationSampler
+{
+public:
+
+	// Builds the tables from the weight of every node. Removed nodes and nodes without weight are never picked.
+	// The pick times are kept, unless the nodes have been numbered again.
+	void Build(const FAI_NavGraph& Graph, const TArray<float>& Weights);
+
+	// Checks if the tables still match a graph: the same nodes can be picked, and each is in the same weak component.
+	// Adding or removing nodes without weight, or links that do not join or split components, leaves them as they are.
+	bool IsUpToDate(const FAI_NavGraph& Graph, const TArray<float>& Weights) const;
+
+	// Removes the tables and the pick times.
+	void Empty();
+
+	// Draws a node of a weak component, or INDEX_NONE if none of its nodes can be picked.
+	int32 Sample(int32 WeakComponent) const;
+
+	// Remembers that a node was picked as a destination.
+	void MarkPicked(int32 Node, double Time);
+
+	// Gets how likely a node is to be kept once drawn, given when it was last picked. Nodes that were picked
+	// more than RecencySeconds ago are always kept, and a node that was just picked is held back by Penalty.
+	float GetRecencyFactor(int32 Node, double Time, float RecencySeconds, float Penalty) const;
+
+private:
+
+	// Checks if a node can be picked as a destination.
+	static bool CanPick(const FAI_NavGraph& Graph, const TArray<float>& Weights, int32 Node);
+
+	// Fills the alias table of the nodes from First up to Last, with chances in proportion to Weights.
+	void BuildAliasTable(int32 First, int32 Last, TArray<float>& Weights);
+
+	// The nodes that can be picked, grouped by weak component.
+	TArray<int32> Nodes;
+
+	// The index of the first node of each weak component, with one extra entry at the end holding the number of nodes.
+	TArray<int32> ComponentOffsets;
+
+	// The chance of keeping each entry rather than taking its alias.
+	TArray<float> Probabilities;
+
+	// The entry taken instead of each entry when it is not kept.
+	TArray<int32> Aliases;
+
+	// When each node was last picked, in world seconds.
+	TArray<double> LastPickedTimes;
+
+	// The version the nodes were numbered at when the pick times were recorded.
+	uint32 LayoutVersion = 0;
+};
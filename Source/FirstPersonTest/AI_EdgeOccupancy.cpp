@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_EdgeOccupancy.h"
+#include "AI_NavGraph.h"
+
+// Each arriving edge is matched with the first leaving edge between the same two nodes that has not been matched yet,
+// so edges that are listed twice still get one counter each.
+FAI_EdgeOccupancy::FAI_EdgeOccupancy(const FAI_NavGraph& Graph, float InCongestionWeight)
+	: Occupants(MakeUnique<std::atomic<int32>[]>(FMath::Max(Graph.NumEdges(), 1)))
+	, CongestionWeight(InCongestionWeight)
+	, GraphVersion(Graph.Version)
+{
+	ReverseEdgeToEdge.Init(INDEX_NONE, Graph.ReverseNeighbours.Num());
+	for (int32 Node = 0; Node < Graph.NumNodes(); Node++)
+	{
+		for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+		{
+			const int32 AdjacentNode = Graph.Neighbours[Edge];
+			for (int32 ReverseEdge = Graph.GetFirstReverseEdge(AdjacentNode); ReverseEdge < Graph.GetLastReverseEdge(AdjacentNode); ReverseEdge++)
+			{
+				if (Graph.ReverseNeighbours[ReverseEdge] == Node && ReverseEdgeToEdge[ReverseEdge] == INDEX_NONE)
+				{
+					ReverseEdgeToEdge[ReverseEdge] = Edge;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void FAI_EdgeOccupancy::Enter(int32 Edge)
+{
+	Occupants[Edge].fetch_add(1, std::memory_order_relaxed);
+	TotalOccupants.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FAI_EdgeOccupancy::Leave(int32 Edge)
+{
+	Occupants[Edge].fetch_sub(1, std::memory_order_relaxed);
+	TotalOccupants.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// The cost only ever grows with the number of agents, so the distances the heuristics are based on still never overestimate.
+float FAI_EdgeOccupancy::GetEdgeCost(const FAI_NavGraph& Graph, int32 Edge, int32 IgnoredEdge) const
+{
+	const int32 NumOccupants = GetOccupants(Edge) - (Edge == IgnoredEdge ? 1 : 0);
+	return Graph.EdgeLengths[Edge] * (1.0f + CongestionWeight * FMath::Max(NumOccupants, 0));
+}
+
+float FAI_EdgeOccupancy::GetReverseEdgeCost(const FAI_NavGraph& Graph, int32 ReverseEdge, int32 IgnoredEdge) const
+{
+	const int32 Edge = ReverseEdgeToEdge[ReverseEdge];
+	return Edge != INDEX_NONE ? GetEdgeCost(Graph, Edge, IgnoredEdge) : Graph.ReverseEdgeLengths[ReverseEdge];
+}
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+struct FAI_NavGraph;
+
+// How many agents are walking along each edge of one version of the navigation graph.
+// Agents add and remove themselves with atomic counters, so searches on worker threads can read the counts while they change.
+// The counts are only a guide, so a search may see some of an agent's moves and not others.
+class FIRSTPERSONTEST_API FAI_EdgeOccupancy
+{
+public:
+
+	// Makes a counter at zero for every edge of a graph.
+	// CongestionWeight is how much longer an edge counts as for each agent on it, as a fraction of its length.
+	FAI_EdgeOccupancy(const FAI_NavGraph& Graph, float InCongestionWeight);
+
+	// Gets the version of the graph the edge indices belong to.
+	uint32 GetGraphVersion() const { return GraphVersion; }
+
+	// Counts an agent onto an edge. Can be called from any thread.
+	void Enter(int32 Edge);
+
+	// Counts an agent off an edge it entered. Can be called from any thread.
+	void Leave(int32 Edge);
+
+	// Gets how many agents are on an edge.
+	int32 GetOccupants(int32 Edge) const { return Occupants[Edge].load(std::memory_order_relaxed); }
+
+	// Gets how many agents are on every edge together. While it is zero, every edge costs its length.
+	int32 GetTotalOccupants() const { return TotalOccupants.load(std::memory_order_relaxed); }
+
+	// Gets the cost of following an edge: its length, made longer by the agents on it.
+	// IgnoredEdge is the edge the agent asking is walking along, which counts one agent fewer, so the agent is never held up by itself.
+	float GetEdgeCost(const FAI_NavGraph& Graph, int32 Edge, int32 IgnoredEdge = INDEX_NONE) const;
+
+	// Gets the cost of following an arriving edge backwards. It costs the same as the edge it is the reverse of.
+	float GetReverseEdgeCost(const FAI_NavGraph& Graph, int32 ReverseEdge, int32 IgnoredEdge = INDEX_NONE) const;
+
+private:
+
+	// The number of agents on each edge.
+	TUniquePtr<std::atomic<int32>[]> Occupants;
+
+	// The number of agents on every edge together.
+	std::atomic<int32> TotalOccupants { 0 };
+
+	// The edge each arriving edge is the reverse of, so backward searches read the same counters.
+	TArray<int32> ReverseEdgeToEdge;
+
+	// How much longer an edge counts as for each agent on it, as a fraction of its length.
+	float CongestionWeight = 0.0f;
+
+	// The version of the graph the edge indices belong to.
+	uint32 GraphVersion = 0;
+};
@@ -0,0 +1,592 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_EnemyManager.h"
+#include "FirstPersonTestCharacter.h"
+#include "Perception/PawnSensingComponent.h"
+
+void UAI_EnemyManager::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PathfindingSubsystem = Collection.InitializeDependency<UAI_Pathfinding>();
+	if (!PathfindingSubsystem)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unable to find the PathfindingSubsystem"))
+	}
+}
+
+// Enemies give their paths back when they end play, which happens before the world's subsystems go away.
+// Any that are left are given back here by slot, as their actors may already have been destroyed.
+void UAI_EnemyManager::Deinitialize()
+{
+	for (int32 Slot = 0; Slot < Enemies.Num(); Slot++)
+	{
+		CancelPathRequest(Slot);
+		ReleaseChaseSearch(Slot);
+		if (PathfindingSubsystem)
+		{
+			PathfindingSubsystem->ReleasePath(Paths[Slot]);
+		}
+	}
+
+	EnemySlots.Empty();
+	Enemies.Empty();
+	SensingComponents.Empty();
+	SensedCharacters.Empty();
+	Settings.Empty();
+	States.Empty();
+	Levels.Empty();
+	LevelTimers.Empty();
+	WaitTimers.Empty();
+	AttackCooldowns.Empty();
+	Waiting.Empty();
+	Active.Empty();
+	FreeRoamCalled.Empty();
+	ReachedDestination.Empty();
+	Attacked.Empty();
+	Locations.Empty();
+	MoveDirections.Empty();
+	MoveScales.Empty();
+	Paths.Empty();
+	HierarchicalPaths.Empty();
+	ChaseSearches.Empty();
+	PendingPathRequests.Empty();
+	ChaseQueries.Empty();
+	ChaseQuerySlots.Empty();
+
+	Super::Deinitialize();
+}
+
+// Every step runs over every enemy before the next one starts, so each step only touches the arrays it needs.
+// Decisions read the locations gathered at the start, and the movement they choose is handed to the actors at the end.
+void UAI_EnemyManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!PathfindingSubsystem || Enemies.IsEmpty())
+	{
+		return;
+	}
+
+	// Enemies that were destroyed without ending play are cleared by the garbage collector. Their slots are removed before anything reads them.
+	// Their keys in EnemySlots no longer match the cleared entries, so the map is made again from the enemies that are left.
+	bool bRemovedEnemies = false;
+	for (int32 Enemy = Enemies.Num() - 1; Enemy >= 0; Enemy--)
+	{
+		if (!Enemies[Enemy])
+		{
+			RemoveSlot(Enemy);
+			bRemovedEnemies = true;
+		}
+	}
+
+	if (bRemovedEnemies)
+	{
+		EnemySlots.Reset();
+		for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+		{
+			EnemySlots.Add(Enemies[Enemy], Enemy);
+		}
+	}
+
+	if (Enemies.IsEmpty())
+	{
+		return;
+	}
+
+	UpdateTimers(DeltaTime);
+
+	for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+	{
+		Locations[Enemy] = Enemies[Enemy]->GetActorLocation();
+	}
+
+	UpdateSight();
+
+	for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+	{
+		MoveScales[Enemy] = 0.0f;
+
+		// Check the AI state:
+		switch (States[Enemy])
+		{
+			case EAI_State::FreeRoam:
+				UpdateFreeRoam(Enemy);
+				break;
+
+			case EAI_State::Chasing:
+				UpdateChase(Enemy);
+				break;
+
+			// Just in case the state is neither Chasing nor free Roaming, set the AI to be free Roaming.
+			default:
+				States[Enemy] = EAI_State::FreeRoam;
+		}
+	}
+
+	ResolveChaseQueries();
+
+	for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+	{
+		if (MoveScales[Enemy] != 0.0f)
+		{
+			Enemies[Enemy]->AddMovementInput(MoveDirections[Enemy], MoveScales[Enemy]);
+		}
+	}
+}
+
+TStatId UAI_EnemyManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAI_EnemyManager, STATGROUP_Tickables);
+}
+
+// The enemy is given the next slot of every array.
+void UAI_EnemyManager::RegisterEnemy(AAI_Enemy* Enemy)
+{
+	if (!Enemy || EnemySlots.Contains(Enemy))
+	{
+		return;
+	}
+
+	const int32 Slot = Enemies.Add(Enemy);
+	EnemySlots.Add(Enemy, Slot);
+	SensingComponents.Add(Enemy->PawnSensingComponent);
+	SensedCharacters.Add(nullptr);
+
+	FAI_EnemySettings& EnemySettings = Settings.AddDefaulted_GetRef();
+	EnemySettings.LevelUpEveryTimeCount = Enemy->LevelUpEveryTimeCount;
+	EnemySettings.PathfindingError = Enemy->PathfindingError;
+	EnemySettings.AttackRange = Enemy->AttackRange;
+	EnemySettings.bShouldAILevelGrowByTime = Enemy->bShouldAILevelGrowByTime;
+	EnemySettings.bShouldAILevelAffectSpeedAndTime = Enemy->bShouldAILevelAffectSpeedAndTime;
+	EnemySettings.bShouldAILevelGrowByChase = Enemy->bShouldAILevelGrowByChase;
+	EnemySettings.bShouldAILeveAffectAttackRange = Enemy->bShouldAILeveAffectAttackRange;
+
+	States.Add(Enemy->CurrentState);
+	Levels.Add(Enemy->AILevel);
+	LevelTimers.Add(0.0f);
+	WaitTimers.Add(0.0f);
+	AttackCooldowns.Add(0.0f);
+	Waiting.Add(false);
+	Active.Add(false);
+	FreeRoamCalled.Add(false);
+	ReachedDestination.Add(false);
+	Attacked.Add(false);
+	Locations.Add(Enemy->GetActorLocation());
+	MoveDirections.Add(FVector::ZeroVector);
+	MoveScales.Add(0.0f);
+	Paths.AddDefaulted();
+	HierarchicalPaths.AddDefaulted();
+	ChaseSearches.AddDefaulted();
+	PendingPathRequests.AddDefaulted();
+
+	// The first path is asked for by FreeRoam once the enemy is active. Enemies begin play while the level's nodes are still registering,
+	// and the graph is only baked on the next tick.
+}
+
+void UAI_EnemyManager::UnregisterEnemy(AAI_Enemy* Enemy)
+{
+	int32 Slot;
+	if (EnemySlots.RemoveAndCopyValue(Enemy, Slot))
+	{
+		RemoveSlot(Slot);
+	}
+}
+
+// The last enemy is moved into the slot of the removed one, so the arrays stay packed.
+void UAI_EnemyManager::RemoveSlot(int32 Slot)
+{
+	CancelPathRequest(Slot);
+	ReleaseChaseSearch(Slot);
+	if (PathfindingSubsystem)
+	{
+		PathfindingSubsystem->ReleasePath(Paths[Slot]);
+	}
+
+	Enemies.RemoveAtSwap(Slot, 1, false);
+	SensingComponents.RemoveAtSwap(Slot, 1, false);
+	SensedCharacters.RemoveAtSwap(Slot, 1, false);
+	Settings.RemoveAtSwap(Slot, 1, false);
+	States.RemoveAtSwap(Slot, 1, false);
+	Levels.RemoveAtSwap(Slot, 1, false);
+	LevelTimers.RemoveAtSwap(Slot, 1, false);
+	WaitTimers.RemoveAtSwap(Slot, 1, false);
+	AttackCooldowns.RemoveAtSwap(Slot, 1, false);
+	Waiting.RemoveAtSwap(Slot);
+	Active.RemoveAtSwap(Slot);
+	FreeRoamCalled.RemoveAtSwap(Slot);
+	ReachedDestination.RemoveAtSwap(Slot);
+	Attacked.RemoveAtSwap(Slot);
+	Locations.RemoveAtSwap(Slot, 1, false);
+	MoveDirections.RemoveAtSwap(Slot, 1, false);
+	MoveScales.RemoveAtSwap(Slot, 1, false);
+	Paths.RemoveAtSwap(Slot, 1, false);
+	HierarchicalPaths.RemoveAtSwap(Slot, 1, false);
+	ChaseSearches.RemoveAtSwap(Slot, 1, false);
+	PendingPathRequests.RemoveAtSwap(Slot, 1, false);
+
+	if (Enemies.IsValidIndex(Slot) && Enemies[Slot])
+	{
+		EnemySlots.Add(Enemies[Slot], Slot);
+	}
+}
+
+void UAI_EnemyManager::OnEnemySensedPlayer(AAI_Enemy* Enemy, AFirstPersonTestCharacter* Player)
+{
+	if (const int32* Slot = EnemySlots.Find(Enemy))
+	{
+		SensedCharacters[*Slot] = Player;
+	}
+}
+
+// The timers count down rather than being set on the timer manager, so they are all updated in one loop.
+void UAI_EnemyManager::UpdateTimers(float DeltaTime)
+{
+	for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+	{
+		// Every certain second/s (LevelUpEveryTimeCount), the AI level will increase by 1.
+		LevelTimers[Enemy] += DeltaTime;
+		if (LevelTimers[Enemy] > Settings[Enemy].LevelUpEveryTimeCount)
+		{
+			if (Settings[Enemy].bShouldAILevelGrowByTime)
+			{
+				UE_LOG(LogTemp, Display, TEXT("AI Level has increased"))
+				Levels[Enemy] += 1;
+			}
+			LevelTimers[Enemy] = 0.0f;
+		}
+
+		// When the AI is finished waiting, it continues with the next round of decisions.
+		if (Waiting[Enemy])
+		{
+			WaitTimers[Enemy] -= DeltaTime;
+			if (WaitTimers[Enemy] <= 0.0f)
+			{
+				UE_LOG(LogTemp, Display, TEXT("Finished Waiting"))
+				Waiting[Enemy] = false;
+			}
+		}
+
+		if (Attacked[Enemy])
+		{
+			AttackCooldowns[Enemy] -= DeltaTime;
+			if (AttackCooldowns[Enemy] <= 0.0f)
+			{
+				UE_LOG(LogTemp, Display, TEXT("The AI is ready to attack again"))
+				Attacked[Enemy] = false;
+			}
+		}
+	}
+}
+
+void UAI_EnemyManager::UpdateSight()
+{
+	for (int32 Enemy = 0; Enemy < Enemies.Num(); Enemy++)
+	{
+		if (!SensedCharacters[Enemy] || !SensingComponents[Enemy])
+		{
+			continue;
+		}
+
+		// The AI has lost track of the player
+		if (!SensingComponents[Enemy]->HasLineOfSightTo(SensedCharacters[Enemy]))
+		{
+			SensedCharacters[Enemy] = nullptr;
+			UE_LOG(LogTemp, Display, TEXT("Lost Player"))
+
+			if (Settings[Enemy].bShouldAILevelGrowByChase)
+			{
+				UE_LOG(LogTemp, Display, TEXT("AI Level has increased"))
+				Levels[Enemy] += 1;
+			}
+		}
+	}
+}
+
+void UAI_EnemyManager::UpdateFreeRoam(int32 Enemy)
+{
+	// 1. If the AI has made it to its destination and finished waiting, then check if the AI will be Active or not.
+	if ((!FreeRoamCalled[Enemy] && ReachedDestination[Enemy] && !Waiting[Enemy]) || (!Active[Enemy] && !Waiting[Enemy]))
+	{
+		UpdateActivity(Enemy);
+	}
+
+	// 2. If the AI will be active, then move it to the next random node location.
+	if (Active[Enemy] && !Waiting[Enemy])
+	{
+		FreeRoam(Enemy);
+	}
+
+	// 3. If the AI has made it to its destination node, then wait a random amount of time.
+	if (ReachedDestination[Enemy] && !Waiting[Enemy])
+	{
+		FreeRoamCalled[Enemy] = false;
+		StartWaiting(Enemy);
+		Active[Enemy] = false;
+		ReachedDestination[Enemy] = false;
+	}
+
+	// 4. If the AI sees a player, the AI will now start chasing
+	if (SensedCharacters[Enemy] && Levels[Enemy] != 0)
+	{
+		States[Enemy] = EAI_State::Chasing;
+		PathfindingSubsystem->ClearPath(Paths[Enemy]);
+		HierarchicalPaths[Enemy].Reset();
+		CancelPathRequest(Enemy);
+	}
+}
+
+void UAI_EnemyManager::UpdateChase(int32 Enemy)
+{
+	Chase(Enemy);
+
+	// Check if the sensed player is close enough to be attacked by the AI
+	if (AFirstPersonTestCharacter* Player = SensedCharacters[Enemy])
+	{
+		const FAI_EnemySettings& EnemySettings = Settings[Enemy];
+		const float AttackRange = EnemySettings.bShouldAILeveAffectAttackRange ? EnemySettings.AttackRange + (Levels[Enemy] * 5) : EnemySettings.AttackRange;
+		if (!Attacked[Enemy] && FVector::Distance(Player->GetActorLocation(), Locations[Enemy]) <= AttackRange)
+		{
+			// The AI attacks the player
+			UE_LOG(LogTemp, Display, TEXT("The AI has attacked the player"))
+			Player->ApplyDamage(10.0f);
+			Attacked[Enemy] = true;
+			AttackCooldowns[Enemy] = 1.0f;
+		}
+	}
+
+	// If the AI loses a player, the AI will now start free-roaming
+	else
+	{
+		States[Enemy] = EAI_State::FreeRoam;
+		CancelPathRequest(Enemy);
+		ReleaseChaseSearch(Enemy);
+	}
+}
+
+void UAI_EnemyManager::UpdateActivity(int32 Enemy)
+{
+	// If the AI Level is 0, then the AI will not move
+	if (Levels[Enemy] == 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("AI Level is set to 0, so it won't move"))
+		return;
+	}
+
+	// Generate a random number and only move the AI if this random number is less than or equal to the AI Level.
+	const int RandomNumber = FMath::FRandRange(1.0f, 20.0f);
+	if (RandomNumber <= Levels[Enemy])
+	{
+		UE_LOG(LogTemp, Display, TEXT("AI is active"))
+		Active[Enemy] = true;
+	}
+
+	// If the random number is bigger than the AI level, then the AI will wait for its next turn.
+	else
+	{
+		UE_LOG(LogTemp, Display, TEXT("AI is NOT active"))
+		StartWaiting(Enemy);
+	}
+}
+
+void UAI_EnemyManager::StartWaiting(int32 Enemy)
+{
+	UE_LOG(LogTemp, Display, TEXT("Started Waiting"))
+
+	float MaxWaitTime = 5.0f;
+	if (Settings[Enemy].bShouldAILevelAffectSpeedAndTime)
+	{
+		MaxWaitTime -= 0.1f * Levels[Enemy];
+		if (MaxWaitTime <= 0.0f)
+		{
+			MaxWaitTime = 0.1f;
+		}
+	}
+
+	// The wait is counted down in UpdateTimers.
+	WaitTimers[Enemy] = FMath::RandRange(0.0f, MaxWaitTime);
+	Waiting[Enemy] = true;
+}
+
+void UAI_EnemyManager::FreeRoam(int32 Enemy)
+{
+	FreeRoamCalled[Enemy] = true;
+
+	FAI_CompactPath& Path = Paths[Enemy];
+	FAI_HierarchicalPath& HierarchicalPath = HierarchicalPaths[Enemy];
+	if (Path.IsEmpty())
+	{
+		// If the path was too long to be kept whole, then ask for the rest of it from where the kept part ended.
+		FVector GoalLocation;
+		if (Path.bTruncated && !PendingPathRequests[Enemy].IsValid() && PathfindingSubsystem->GetPathGoal(Path, GoalLocation))
+		{
+			Path.bTruncated = false;
+			PendingPathRequests[Enemy] = PathfindingSubsystem->RequestPath(Locations[Enemy], GoalLocation,
+				FAI_OnPathRequestComplete::CreateUObject(this, &UAI_EnemyManager::OnPathFound, TWeakObjectPtr<AAI_Enemy>(Enemies[Enemy])),
+				EAI_SearchMode::Default, EAI_PathRequestPriority::Normal, &Path);
+		}
+
+		// If the AI is following a path across clusters, then fill in the part up to the next cluster.
+		else if (HierarchicalPath.HasRemainingSegments())
+		{
+			if (!PathfindingSubsystem->RefineHierarchicalPath(HierarchicalPath, Path))
+			{
+				HierarchicalPath.Reset();
+			}
+		}
+
+		// On large maps, get a random path at the cluster level. Only the first cluster is filled in straight away.
+		else if (PathfindingSubsystem->UsesHierarchicalPaths())
+		{
+			if (PathfindingSubsystem->GetRandomHierarchicalPath(Locations[Enemy], HierarchicalPath))
+			{
+				PathfindingSubsystem->RefineHierarchicalPath(HierarchicalPath, Path);
+			}
+		}
+
+		// Otherwise ask for a random path of nodes. It is searched on a worker thread and arrives in OnPathFound.
+		else if (!PendingPathRequests[Enemy].IsValid())
+		{
+			RequestRandomPath(Enemy);
+		}
+	}
+
+	MoveAlongPath(Enemy, 0.25f);
+}
+
+void UAI_EnemyManager::Chase(int32 Enemy)
+{
+	const AFirstPersonTestCharacter* Player = SensedCharacters[Enemy];
+	if (!Player)
+	{
+		return;
+	}
+
+	// Every AI chasing the same player shares a flow field towards them, so reading a path from it is cheap enough to do straight away.
+	// A new path is read before the current one runs out.
+	FAI_CompactPath& Path = Paths[Enemy];
+	if (PathfindingSubsystem->UsesChaseFlowFields())
+	{
+		if (Path.NumRemaining() <= 1)
+		{
+			PathfindingSubsystem->GetChasePath(Locations[Enemy], Player, Path);
+		}
+	}
+
+	// Otherwise keep an incremental search towards the player. It gives a new path as soon as the player moves to a different node,
+	// and only redoes the part of the search that the move affected.
+	else if (PathfindingSubsystem->UsesIncrementalChaseSearch())
+	{
+		if (!ChaseSearches[Enemy].IsValid())
+		{
+			ChaseSearches[Enemy] = PathfindingSubsystem->CreateChaseSearch();
+		}
+		PathfindingSubsystem->UpdateChaseSearch(ChaseSearches[Enemy], Locations[Enemy], Player, Path.NumRemaining() <= 1, Path);
+	}
+
+	// Otherwise ask for a path once every enemy has decided, so the AI keeps moving along its current path this frame.
+	else if (Path.NumRemaining() <= 1)
+	{
+		ChaseQueries.Add({Locations[Enemy], Player->GetActorLocation()});
+		ChaseQuerySlots.Add(Enemy);
+	}
+
+	MoveAlongPath(Enemy, 1.0f);
+}
+
+// Enemies chasing the same player head to the same node, so the pathfinding subsystem can answer them with one search from the player.
+void UAI_EnemyManager::ResolveChaseQueries()
+{
+	if (ChaseQueries.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<FAI_CompactPath*, TInlineAllocator<32>> QueryPaths;
+	QueryPaths.Reserve(ChaseQuerySlots.Num());
+	for (const int32 Enemy : ChaseQuerySlots)
+	{
+		QueryPaths.Add(&Paths[Enemy]);
+	}
+	PathfindingSubsystem->GetPaths(ChaseQueries, QueryPaths);
+
+	ChaseQueries.Reset();
+	ChaseQuerySlots.Reset();
+}
+
+// Only the direction and speed are worked out here. They are handed to the actor's movement component at the end of the update.
+void UAI_EnemyManager::MoveAlongPath(int32 Enemy, float MovementSpeed)
+{
+	FAI_CompactPath& Path = Paths[Enemy];
+	if (Path.IsEmpty())
+	{
+		return;
+	}
+
+	// If the path belongs to an old version of the graph, then drop it so a new one is asked for.
+	FVector Waypoint;
+	if (!PathfindingSubsystem->GetPathWaypoint(Path, Waypoint))
+	{
+		PathfindingSubsystem->ClearPath(Path);
+		return;
+	}
+
+	MoveDirections[Enemy] = (Waypoint - Locations[Enemy]).GetSafeNormal();
+	MoveScales[Enemy] = Settings[Enemy].bShouldAILevelAffectSpeedAndTime ? MovementSpeed + (Levels[Enemy] / 100) : MovementSpeed;
+
+	// Check if it is close to the current stage of the path
+	if (FVector::Distance(Locations[Enemy], Waypoint) < Settings[Enemy].PathfindingError)
+	{
+		ReachedDestination[Enemy] = true;
+		UE_LOG(LogTemp, Display, TEXT("Made it to destination"))
+		PathfindingSubsystem->AdvancePath(Path);
+	}
+}
+
+// The enemy is looked up by its actor, as it may have moved to another slot since it asked, or been removed.
+void UAI_EnemyManager::OnPathFound(FAI_PathRequestHandle Handle, const TArray<int32>& PathNodes, uint32 GraphVersion, TWeakObjectPtr<AAI_Enemy> Enemy)
+{
+	const int32* Slot = EnemySlots.Find(Enemy.Get());
+
+	// Ignore paths for requests the AI is no longer waiting on.
+	if (!Slot || Handle != PendingPathRequests[*Slot])
+	{
+		return;
+	}
+
+	PendingPathRequests[*Slot].Invalidate();
+
+	// If no path was found, then keep the old one. A new path will be asked for on the next update.
+	if (!PathNodes.IsEmpty())
+	{
+		PathfindingSubsystem->AssignPath(Paths[*Slot], PathNodes, GraphVersion);
+	}
+}
+
+void UAI_EnemyManager::RequestRandomPath(int32 Enemy)
+{
+	if (PathfindingSubsystem)
+	{
+		PendingPathRequests[Enemy] = PathfindingSubsystem->RequestRandomPath(Locations[Enemy],
+			FAI_OnPathRequestComplete::CreateUObject(this, &UAI_EnemyManager::OnPathFound, TWeakObjectPtr<AAI_Enemy>(Enemies[Enemy])),
+			EAI_SearchMode::Default, EAI_PathRequestPriority::Normal, &Paths[Enemy]);
+	}
+}
+
+void UAI_EnemyManager::CancelPathRequest(int32 Enemy)
+{
+	if (PendingPathRequests[Enemy].IsValid() && PathfindingSubsystem)
+	{
+		PathfindingSubsystem->CancelPathRequest(PendingPathRequests[Enemy]);
+	}
+	PendingPathRequests[Enemy].Invalidate();
+}
+
+void UAI_EnemyManager::ReleaseChaseSearch(int32 Enemy)
+{
+	if (ChaseSearches[Enemy].IsValid() && PathfindingSubsystem)
+	{
+		PathfindingSubsystem->ReleaseChaseSearch(ChaseSearches[Enemy]);
+	}
+	ChaseSearches[Enemy].Invalidate();
+}
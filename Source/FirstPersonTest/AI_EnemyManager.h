@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AI_Enemy.h"
+#include "AI_Pathfinding.h"
+#include "AI_EnemyManager.generated.h"
+
+class AFirstPersonTestCharacter;
+class UPawnSensingComponent;
+
+// The settings of an enemy that do not change while it plays, copied from the actor when it registers
+struct FIRSTPERSONTEST_API FAI_EnemySettings
+{
+	// How long the enemy takes to level up, in seconds.
+	float LevelUpEveryTimeCount = 10.0f;
+
+	// The distance where a node of the path is considered reached.
+	float PathfindingError = 150.0f;
+
+	// The distance the enemy can attack the player from.
+	float AttackRange = 300.0f;
+
+	// Whether the enemy levels up as time goes on.
+	bool bShouldAILevelGrowByTime = false;
+
+	// Whether the enemy's level affects how fast it moves and how long it waits.
+	bool bShouldAILevelAffectSpeedAndTime = false;
+
+	// Whether the enemy levels up whenever it loses a player it was chasing.
+	bool bShouldAILevelGrowByChase = false;
+
+	// Whether the enemy's level makes its attack reach further.
+	bool bShouldAILeveAffectAttackRange = false;
+};
+
+// Makes the decisions of every AI_Enemy in the world in one pass each frame, instead of each enemy ticking on its own.
+// The state of every enemy is kept in arrays indexed by the enemy's slot, one array per value, so each step of the update
+// walks contiguous memory. Enemies are removed by moving the last enemy into their slot, so the arrays never have gaps.
+// The actors only keep their movement and sensing components, and are handed the direction to move in at the end of the pass.
+UCLASS()
+class FIRSTPERSONTEST_API UAI_EnemyManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	// Makes sure the pathfinding subsystem is there before the first enemy registers.
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// Forgets every enemy.
+	virtual void Deinitialize() override;
+
+	// Updates every enemy: timers first, then sight, then decisions, then movement.
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Adds an enemy. Enemies call this when they begin play.
+	void RegisterEnemy(AAI_Enemy* Enemy);
+
+	// Removes an enemy and gives back its path and searches. Enemies call this when they end play.
+	void UnregisterEnemy(AAI_Enemy* Enemy);
+
+	// Tells an enemy that it has seen a player.
+	void OnEnemySensedPlayer(AAI_Enemy* Enemy, AFirstPersonTestCharacter* Player);
+
+	// Gets how many enemies are registered.
+	int32 NumEnemies() const { return Enemies.Num(); }
+
+protected:
+
+	// The enemy actors, by slot
+	UPROPERTY()
+	TArray<AAI_Enemy*> Enemies;
+
+	// The sensing component of each enemy, used to check if it can still see the player it is chasing
+	UPROPERTY()
+	TArray<UPawnSensingComponent*> SensingComponents;
+
+	// The player each enemy has seen, or null
+	UPROPERTY()
+	TArray<AFirstPersonTestCharacter*> SensedCharacters;
+
+	// The pathfinding subsystem every enemy gets its paths from
+	UPROPERTY()
+	UAI_Pathfinding* PathfindingSubsystem;
+
+	// The slot of each enemy actor
+	TMap<const AAI_Enemy*, int32> EnemySlots;
+
+	// The settings of each enemy
+	TArray<FAI_EnemySettings> Settings;
+
+	// Whether each enemy is free roaming or chasing
+	TArray<EAI_State> States;
+
+	// How active each enemy is. 1 - Not active, 20 - always active.
+	TArray<int32> Levels;
+
+	// The time since each enemy last levelled up, in seconds
+	TArray<float> LevelTimers;
+
+	// The time each waiting enemy has left to wait, in seconds
+	TArray<float> WaitTimers;
+
+	// The time left before each enemy that has attacked can attack again, in seconds
+	TArray<float> AttackCooldowns;
+
+	// Whether each enemy is waiting
+	TBitArray<> Waiting;
+
+	// Whether each enemy is active
+	TBitArray<> Active;
+
+	// Whether each enemy has started free roaming since it last waited
+	TBitArray<> FreeRoamCalled;
+
+	// Whether each enemy has reached the next node of its path
+	TBitArray<> ReachedDestination;
+
+	// Whether each enemy has attacked lately
+	TBitArray<> Attacked;
+
+	// The location of each enemy, read once at the start of the update
+	TArray<FVector> Locations;
+
+	// The direction each enemy moves in this frame
+	TArray<FVector> MoveDirections;
+
+	// How fast each enemy moves this frame, or zero if it stands still
+	TArray<float> MoveScales;
+
+	// The nodes each enemy is planning to go to
+	TArray<FAI_CompactPath> Paths;
+
+	// The cluster level path each enemy is following on large maps
+	TArray<FAI_HierarchicalPath> HierarchicalPaths;
+
+	// The incremental search each enemy keeps towards the player while chasing without flow fields
+	TArray<FAI_IncrementalSearchHandle> ChaseSearches;
+
+	// The path each enemy has asked for and is still waiting on
+	TArray<FAI_PathRequestHandle> PendingPathRequests;
+
+	// The chase paths wanted this frame, answered together once every enemy has decided
+	TArray<FAI_PathQuery> ChaseQueries;
+
+	// The slot of the enemy that wants each chase path
+	TArray<int32> ChaseQuerySlots;
+
+private:
+
+	// Counts down the level, wait and attack timers of every enemy.
+	void UpdateTimers(float DeltaTime);
+
+	// Checks if the enemies chasing a player can still see them.
+	void UpdateSight();
+
+	// Makes the decisions of an enemy that is free roaming.
+	void UpdateFreeRoam(int32 Enemy);
+
+	// Makes the decisions of an enemy that is chasing a player.
+	void UpdateChase(int32 Enemy);
+
+	// Based on the enemy's level, decides if it moves or waits.
+	void UpdateActivity(int32 Enemy);
+
+	// Stops the enemy and makes it wait a random amount of time.
+	void StartWaiting(int32 Enemy);
+
+	// Moves the enemy to random locations at random times.
+	void FreeRoam(int32 Enemy);
+
+	// Finds the shortest path to reach the player.
+	void Chase(int32 Enemy);
+
+	// Removes the enemy in a slot and gives back its path and searches.
+	void RemoveSlot(int32 Slot);
+
+	// Gets every chase path wanted this frame in one batch.
+	void ResolveChaseQueries();
+
+	// Moves the enemy towards the next node of its path.
+	void MoveAlongPath(int32 Enemy, float MovementSpeed);
+
+	// Replaces the path of the enemy that asked for it once it has been found.
+	void OnPathFound(FAI_PathRequestHandle Handle, const TArray<int32>& PathNodes, uint32 GraphVersion, TWeakObjectPtr<AAI_Enemy> Enemy);
+
+	// Asks for a random path for an enemy.
+	void RequestRandomPath(int32 Enemy);
+
+	// Stops waiting for the path the enemy has asked for, if there is one.
+	void CancelPathRequest(int32 Enemy);
+
+	// Gives the incremental search of the enemy back to the pathfinding subsystem, if it has one.
+	void ReleaseChaseSearch(int32 Enemy);
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_FlowField.h"
+#include "AI_EdgeOccupancy.h"
+#include "AI_NavGraph.h"
+#include "AI_PathSearch.h"
+#include "Algo/Reverse.h"
+
+// Searching backwards from the goal makes the came from link of every node point at the next node towards the goal.
+void FAI_FlowField::Build(const FAI_NavGraph& Graph, int32 NewGoalNode, FAI_SearchContext& Context)
+{
+	const int32 NodeCount = Graph.NumNodes();
+
+	GoalNode = NewGoalNode;
+	GraphVersion = Graph.Version;
+	Distances.SetNumUninitialized(NodeCount);
+	NextHops.SetNumUninitialized(NodeCount);
+
+	Context.FindAllDistances(Graph, GoalNode, true);
+
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		if (Context.IsVisited(Node))
+		{
+			Distances[Node] = Context.GScores[Node];
+			NextHops[Node] = Context.CameFrom[Node];
+		}
+		else
+		{
+			Distances[Node] = UE_MAX_FLT;
+			NextHops[Node] = INDEX_NONE;
+		}
+	}
+}
+
+// Follows the next nodes to the goal, then flips the path around to match the order of searched paths.
+bool FAI_FlowField::GetPath(int32 StartNode, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	// If the goal cannot be reached from the start node, then return an empty path.
+	if (Distances[StartNode] == UE_MAX_FLT)
+	{
+		return false;
+	}
+
+	int32 CurrentNode = StartNode;
+	OutNodes.Add(CurrentNode);
+
+	while (CurrentNode != GoalNode)
+	{
+		CurrentNode = NextHops[CurrentNode];
+		OutNodes.Add(CurrentNode);
+	}
+
+	Algo::Reverse(OutNodes);
+	return true;
+}
+
+// Every agent reading the same field would otherwise take the same edges. Weighing the cost of the next edge, with the agents on it,
+// against the distance left from where it leads spreads them over the other edges that lead towards the goal.
+int32 FAI_FlowField::GetNextHopAroundTraffic(const FAI_NavGraph& Graph, const FAI_EdgeOccupancy& EdgeOccupancy, int32 IgnoredEdge, int32 Node) const
+{
+	if (Distances[Node] == UE_MAX_FLT || Node == GoalNode)
+	{
+		return NextHops[Node];
+	}
+
+	int32 BestNode = NextHops[Node];
+	float BestCost = UE_MAX_FLT;
+	for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+	{
+		const int32 AdjacentNode = Graph.Neighbours[Edge];
+		if (Distances[AdjacentNode] >= Distances[Node])
+		{
+			continue;
+		}
+
+		const float Cost = EdgeOccupancy.GetEdgeCost(Graph, Edge, IgnoredEdge) + Distances[AdjacentNode];
+		if (Cost < BestCost)
+		{
+			BestCost = Cost;
+			BestNode = AdjacentNode;
+		}
+	}
+	return BestNode;
+}
+
+bool FAI_FlowField::GetPathAroundTraffic(const FAI_NavGraph& Graph, const FAI_EdgeOccupancy& EdgeOccupancy, int32 IgnoredEdge, int32 StartNode, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	if (Distances[StartNode] == UE_MAX_FLT)
+	{
+		return false;
+	}
+
+	int32 CurrentNode = StartNode;
+	OutNodes.Add(CurrentNode);
+
+	while (CurrentNode != GoalNode)
+	{
+		CurrentNode = GetNextHopAroundTraffic(Graph, EdgeOccupancy, IgnoredEdge, CurrentNode);
+		OutNodes.Add(CurrentNode);
+	}
+
+	Algo::Reverse(OutNodes);
+	return true;
+}
@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+class FAI_EdgeOccupancy;
+struct FAI_SearchContext;
+
+// The distance to a goal node and the next node towards it, for every node of the graph.
+// One field is shared by every enemy heading to the same goal, so each of them reads its next node instead of searching.
+struct FIRSTPERSONTEST_API FAI_FlowField
+{
+	// Runs a backwards search from the goal node and stores the result for every node.
+	void Build(const FAI_NavGraph& Graph, int32 NewGoalNode, FAI_SearchContext& Context);
+
+	// Checks if the field leads to a goal node on a version of the navigation graph.
+	bool IsBuiltFor(int32 Node, uint32 InGraphVersion) const { return GoalNode == Node && GraphVersion == InGraphVersion; }
+
+	// Gets the next node towards the goal, or INDEX_NONE if the goal cannot be reached from the node.
+	int32 GetNextHop(int32 Node) const { return NextHops[Node]; }
+
+	// Gets the distance from a node to the goal, or UE_MAX_FLT if the goal cannot be reached from the node.
+	float GetDistance(int32 Node) const { return Distances[Node]; }
+
+	// Gets the nodes of the path from a node to the goal, from the goal back to the node.
+	// Returns false if the goal cannot be reached.
+	bool GetPath(int32 StartNode, TArray<int32>& OutNodes) const;
+
+	// Gets the next node towards the goal, going around edges that other agents are walking along when another edge is cheaper.
+	// Only nodes closer to the goal are picked, so the agent always gets closer. Returns INDEX_NONE if the goal cannot be reached.
+	// IgnoredEdge is the edge the agent is walking along, which counts one agent fewer.
+	int32 GetNextHopAroundTraffic(const FAI_NavGraph& Graph, const FAI_EdgeOccupancy& EdgeOccupancy, int32 IgnoredEdge, int32 Node) const;
+
+	// Gets the nodes of a path to the goal like GetPath, picking each node with GetNextHopAroundTraffic.
+	bool GetPathAroundTraffic(const FAI_NavGraph& Graph, const FAI_EdgeOccupancy& EdgeOccupancy, int32 IgnoredEdge, int32 StartNode, TArray<int32>& OutNodes) const;
+
+	// The node the field leads to.
+	int32 GoalNode = INDEX_NONE;
+
+	// The version of the graph the field was built for.
+	uint32 GraphVersion = 0;
+
+	// The frame the goal node was last checked on.
+	uint64 LastUpdateFrame = 0;
+
+	// The distance from every node to the goal.
+	TArray<float> Distances;
+
+	// The next node towards the goal from every node.
+	TArray<int32> NextHops;
+};
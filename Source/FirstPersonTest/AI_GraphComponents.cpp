@@ -0,0 +1,340 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_GraphComponents.h"
+#include "AI_NavGraph.h"
+#include "AI_NavGraphFile.h"
+
+void FAI_GraphComponents::Build(const FAI_NavGraph& Graph, int32 MaxTableComponents)
+{
+	Empty();
+
+	if (Graph.NumNodes() == 0)
+	{
+		return;
+	}
+
+	BuildStrongComponents(Graph);
+	BuildWeakComponents(Graph);
+
+	if (NumStrongComponents() <= MaxTableComponents)
+	{
+		BuildReachabilityTable(Graph);
+	}
+}
+
+void FAI_GraphComponents::Empty()
+{
+	StrongComponents.Reset();
+	StrongComponentNodes.Reset();
+	StrongComponentOffsets.Reset();
+	WeakComponents.Reset();
+	WeakComponentNodes.Reset();
+	WeakComponentOffsets.Reset();
+	ReachableComponents.Reset();
+	ReachableNodeCounts.Reset();
+	TableWords = 0;
+}
+
+void FAI_GraphComponents::SaveTo(FAI_NavGraphFileWriter& File) const
+{
+	File.AddSection(EAI_NavGraphSection::StrongComponents, StrongComponents);
+	File.AddSection(EAI_NavGraphSection::StrongComponentNodes, StrongComponentNodes);
+	File.AddSection(EAI_NavGraphSection::StrongComponentOffsets, StrongComponentOffsets);
+	File.AddSection(EAI_NavGraphSection::WeakComponents, WeakComponents);
+	File.AddSection(EAI_NavGraphSection::WeakComponentNodes, WeakComponentNodes);
+	File.AddSection(EAI_NavGraphSection::WeakComponentOffsets, WeakComponentOffsets);
+	if (HasReachabilityTable())
+	{
+		File.AddSection(EAI_NavGraphSection::ReachableComponents, ReachableComponents);
+		File.AddSection(EAI_NavGraphSection::ReachableNodeCounts, ReachableNodeCounts);
+	}
+}
+
+// The reachability table is optional, as graphs with too many components are saved without one.
+bool FAI_GraphComponents::LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes)
+{
+	Empty();
+
+	const bool bRead = File.ReadSection(EAI_NavGraphSection::StrongComponents, StrongComponents)
+		&& File.ReadSection(EAI_NavGraphSection::StrongComponentNodes, StrongComponentNodes)
+		&& File.ReadSection(EAI_NavGraphSection::StrongComponentOffsets, StrongComponentOffsets)
+		&& File.ReadSection(EAI_NavGraphSection::WeakComponents, WeakComponents)
+		&& File.ReadSection(EAI_NavGraphSection::WeakComponentNodes, WeakComponentNodes)
+		&& File.ReadSection(EAI_NavGraphSection::WeakComponentOffsets, WeakComponentOffsets);
+
+	bool bValid = bRead && StrongComponents.Num() == NumExpectedNodes && StrongComponentNodes.Num() == NumExpectedNodes
+		&& WeakComponents.Num() == NumExpectedNodes && WeakComponentNodes.Num() == NumExpectedNodes
+		&& StrongComponentOffsets.Num() > 0 && WeakComponentOffsets.Num() > 0;
+
+	if (bValid && File.HasSection(EAI_NavGraphSection::ReachableComponents))
+	{
+		TableWords = (NumStrongComponents() + 63) / 64;
+		bValid = File.ReadSection(EAI_NavGraphSection::ReachableComponents, ReachableComponents)
+			&& File.ReadSection(EAI_NavGraphSection::ReachableNodeCounts, ReachableNodeCounts)
+			&& ReachableComponents.Num() == NumStrongComponents() * TableWords && ReachableNodeCounts.Num() == NumStrongComponents();
+	}
+
+	if (!bValid)
+	{
+		Empty();
+	}
+	return bValid;
+}
+
+// Nodes in different weak components can never reach each other, and nodes in the same strong component always can.
+// Only the pairs in between need the table.
+bool FAI_GraphComponents::AreConnected(int32 FromNode, int32 ToNode) const
+{
+	if (StrongComponents.IsEmpty())
+	{
+		return true;
+	}
+
+	if (WeakComponents[FromNode] != WeakComponents[ToNode])
+	{
+		return false;
+	}
+
+	const int32 FromComponent = StrongComponents[FromNode];
+	const int32 ToComponent = StrongComponents[ToNode];
+	if (FromComponent == ToComponent || !HasReachabilityTable())
+	{
+		return true;
+	}
+
+	return CanReach(FromComponent, ToComponent);
+}
+
+// Picks a position among every node the start node can reach, then walks the reachable components to find which node it falls on.
+// Every reachable node is equally likely to be picked.
+int32 FAI_GraphComponents::GetRandomReachableNode(int32 FromNode) const
+{
+	if (StrongComponents.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	// Without the table, pick from the nodes of the same weak component.
+	if (!HasReachabilityTable())
+	{
+		const int32 Component = WeakComponents[FromNode];
+		const int32 First = WeakComponentOffsets[Component];
+		return WeakComponentNodes[FMath::RandRange(First, WeakComponentOffsets[Component + 1] - 1)];
+	}
+
+	const int32 FromComponent = StrongComponents[FromNode];
+	int32 Remaining = FMath::RandRange(0, ReachableNodeCounts[FromComponent] - 1);
+
+	const uint64* Row = ReachableComponents.GetData() + FromComponent * TableWords;
+	for (int32 Word = 0; Word < TableWords; Word++)
+	{
+		for (uint64 Bits = Row[Word]; Bits != 0; Bits &= Bits - 1)
+		{
+			const int32 Component = Word * 64 + int32(FMath::CountTrailingZeros64(Bits));
+			const int32 First = StrongComponentOffsets[Component];
+			const int32 Size = StrongComponentOffsets[Component + 1] - First;
+			if (Remaining < Size)
+			{
+				return StrongComponentNodes[First + Remaining];
+			}
+			Remaining -= Size;
+		}
+	}
+
+	return FromNode;
+}
+
+// Tarjan's algorithm with an explicit stack instead of recursion, so large graphs cannot overflow the call stack.
+// A component is finished only after every component it leads to, so the components come out in reverse topological order.
+void FAI_GraphComponents::BuildStrongComponents(const FAI_NavGraph& Graph)
+{
+	const int32 NodeCount = Graph.NumNodes();
+
+	TArray<int32> VisitOrder;
+	TArray<int32> LowLinks;
+	TArray<bool> OnStack;
+	TArray<int32> ComponentStack;
+	TArray<TPair<int32, int32>> CallStack;
+	VisitOrder.Init(INDEX_NONE, NodeCount);
+	LowLinks.SetNumUninitialized(NodeCount);
+	OnStack.Init(false, NodeCount);
+	StrongComponents.Init(INDEX_NONE, NodeCount);
+
+	int32 NextVisit = 0;
+	int32 ComponentCount = 0;
+
+	auto VisitNode = [&](int32 Node)
+	{
+		VisitOrder[Node] = NextVisit;
+		LowLinks[Node] = NextVisit;
+		NextVisit++;
+		ComponentStack.Push(Node);
+		OnStack[Node] = true;
+		CallStack.Emplace(Node, Graph.GetFirstEdge(Node));
+	};
+
+	for (int32 RootNode = 0; RootNode < NodeCount; RootNode++)
+	{
+		if (VisitOrder[RootNode] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		VisitNode(RootNode);
+		while (!CallStack.IsEmpty())
+		{
+			const int32 Node = CallStack.Last().Key;
+			const int32 Edge = CallStack.Last().Value;
+
+			// Follow the next edge of the node.
+			if (Edge < Graph.GetLastEdge(Node))
+			{
+				CallStack.Last().Value++;
+
+				const int32 AdjacentNode = Graph.Neighbours[Edge];
+				if (VisitOrder[AdjacentNode] == INDEX_NONE)
+				{
+					VisitNode(AdjacentNode);
+				}
+				else if (OnStack[AdjacentNode])
+				{
+					LowLinks[Node] = FMath::Min(LowLinks[Node], VisitOrder[AdjacentNode]);
+				}
+				continue;
+			}
+
+			// Every edge has been followed. If nothing below the node leads back above it, then the node is the root of a component.
+			CallStack.Pop(false);
+			if (LowLinks[Node] == VisitOrder[Node])
+			{
+				int32 ComponentNode;
+				do
+				{
+					ComponentNode = ComponentStack.Pop(false);
+					OnStack[ComponentNode] = false;
+					StrongComponents[ComponentNode] = ComponentCount;
+				}
+				while (ComponentNode != Node);
+				ComponentCount++;
+			}
+
+			if (!CallStack.IsEmpty())
+			{
+				const int32 ParentNode = CallStack.Last().Key;
+				LowLinks[ParentNode] = FMath::Min(LowLinks[ParentNode], LowLinks[Node]);
+			}
+		}
+	}
+
+	GroupNodes(StrongComponents, ComponentCount, StrongComponentNodes, StrongComponentOffsets);
+}
+
+void FAI_GraphComponents::BuildWeakComponents(const FAI_NavGraph& Graph)
+{
+	const int32 NodeCount = Graph.NumNodes();
+
+	WeakComponents.Init(INDEX_NONE, NodeCount);
+	TArray<int32> OpenNodes;
+	int32 ComponentCount = 0;
+
+	for (int32 RootNode = 0; RootNode < NodeCount; RootNode++)
+	{
+		if (WeakComponents[RootNode] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		WeakComponents[RootNode] = ComponentCount;
+		OpenNodes.Push(RootNode);
+		while (!OpenNodes.IsEmpty())
+		{
+			const int32 Node = OpenNodes.Pop(false);
+
+			for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+			{
+				if (WeakComponents[Graph.Neighbours[Edge]] == INDEX_NONE)
+				{
+					WeakComponents[Graph.Neighbours[Edge]] = ComponentCount;
+					OpenNodes.Push(Graph.Neighbours[Edge]);
+				}
+			}
+			for (int32 Edge = Graph.GetFirstReverseEdge(Node); Edge < Graph.GetLastReverseEdge(Node); Edge++)
+			{
+				if (WeakComponents[Graph.ReverseNeighbours[Edge]] == INDEX_NONE)
+				{
+					WeakComponents[Graph.ReverseNeighbours[Edge]] = ComponentCount;
+					OpenNodes.Push(Graph.ReverseNeighbours[Edge]);
+				}
+			}
+		}
+		ComponentCount++;
+	}
+
+	GroupNodes(WeakComponents, ComponentCount, WeakComponentNodes, WeakComponentOffsets);
+}
+
+// Every edge between components leads to a component with a smaller number, so going through the components in order
+// means the rows of the components an edge leads to are always finished before they are merged in.
+void FAI_GraphComponents::BuildReachabilityTable(const FAI_NavGraph& Graph)
+{
+	const int32 ComponentCount = NumStrongComponents();
+	TableWords = (ComponentCount + 63) / 64;
+	ReachableComponents.SetNumZeroed(ComponentCount * TableWords);
+	ReachableNodeCounts.SetNumZeroed(ComponentCount);
+
+	for (int32 Component = 0; Component < ComponentCount; Component++)
+	{
+		uint64* Row = ReachableComponents.GetData() + Component * TableWords;
+		Row[Component >> 6] |= uint64(1) << (Component & 63);
+
+		for (int32 Index = StrongComponentOffsets[Component]; Index < StrongComponentOffsets[Component + 1]; Index++)
+		{
+			const int32 Node = StrongComponentNodes[Index];
+			for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+			{
+				const int32 AdjacentComponent = StrongComponents[Graph.Neighbours[Edge]];
+				if (AdjacentComponent == Component || CanReach(Component, AdjacentComponent))
+				{
+					continue;
+				}
+
+				const uint64* AdjacentRow = ReachableComponents.GetData() + AdjacentComponent * TableWords;
+				for (int32 Word = 0; Word < TableWords; Word++)
+				{
+					Row[Word] |= AdjacentRow[Word];
+				}
+			}
+		}
+
+		// Count the nodes of every reachable component, so random destinations can be picked evenly.
+		for (int32 Word = 0; Word < TableWords; Word++)
+		{
+			for (uint64 Bits = Row[Word]; Bits != 0; Bits &= Bits - 1)
+			{
+				const int32 ReachableComponent = Word * 64 + int32(FMath::CountTrailingZeros64(Bits));
+				ReachableNodeCounts[Component] += StrongComponentOffsets[ReachableComponent + 1] - StrongComponentOffsets[ReachableComponent];
+			}
+		}
+	}
+}
+
+// A counting sort, as the labels are already small dense numbers.
+void FAI_GraphComponents::GroupNodes(const TArray<int32>& Labels, int32 NumLabels, TArray<int32>& OutNodes, TArray<int32>& OutOffsets)
+{
+	OutOffsets.SetNumZeroed(NumLabels + 1);
+	for (const int32 Label : Labels)
+	{
+		OutOffsets[Label + 1]++;
+	}
+	for (int32 Label = 0; Label < NumLabels; Label++)
+	{
+		OutOffsets[Label + 1] += OutOffsets[Label];
+	}
+
+	TArray<int32> NextIndex(OutOffsets.GetData(), NumLabels);
+	OutNodes.SetNumUninitialized(Labels.Num());
+	for (int32 Node = 0; Node < Labels.Num(); Node++)
+	{
+		OutNodes[NextIndex[Labels[Node]]++] = Node;
+	}
+}
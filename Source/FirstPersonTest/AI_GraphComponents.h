@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+class FAI_NavGraphFileReader;
+class FAI_NavGraphFileWriter;
+
+// Which nodes of the navigation graph can reach which, worked out once when the graph is built.
+// Nodes are grouped into strongly connected components, where every node can reach every other node of its component.
+// For graphs with few enough components, a table of which components can reach which answers any reachability question in constant time.
+class FIRSTPERSONTEST_API FAI_GraphComponents
+{
+public:
+
+	// Labels every node with its components. The reachability table is only built if there are at most MaxTableComponents strong components.
+	void Build(const FAI_NavGraph& Graph, int32 MaxTableComponents);
+
+	// Removes every label.
+	void Empty();
+
+	// Adds the labels and the reachability table to a cooked graph file.
+	void SaveTo(FAI_NavGraphFileWriter& File) const;
+
+	// Reads the labels and the reachability table from a cooked graph file instead of building them.
+	// Returns false, leaving the labels empty, if the file does not hold labels for NumExpectedNodes nodes.
+	bool LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes);
+
+	// Checks if there is a path from one node to another.
+	// Without the reachability table, nodes in the same weakly connected part of the graph are assumed to be connected.
+	bool AreConnected(int32 FromNode, int32 ToNode) const;
+
+	// Gets a random node that can be reached from a node, or INDEX_NONE if the components have not been built.
+	int32 GetRandomReachableNode(int32 FromNode) const;
+
+	// Gets the number of strongly connected components.
+	int32 NumStrongComponents() const { return StrongComponentOffsets.Num() > 0 ? StrongComponentOffsets.Num() - 1 : 0; }
+
+	// Gets the weakly connected component of a node, or INDEX_NONE if the components have not been built.
+	int32 GetWeakComponent(int32 Node) const { return WeakComponents.IsValidIndex(Node) ? WeakComponents[Node] : INDEX_NONE; }
+
+	// Gets the number of weakly connected components, which ignore the direction of edges.
+	int32 NumWeakComponents() const { return WeakComponentOffsets.Num() > 0 ? WeakComponentOffsets.Num() - 1 : 0; }
+
+	// Checks if the reachability table was built.
+	bool HasReachabilityTable() const { return ReachableComponents.Num() > 0; }
+
+private:
+
+	// Labels the strong components with Tarjan's algorithm. Components are numbered so that every edge between them leads to a smaller number.
+	void BuildStrongComponents(const FAI_NavGraph& Graph);
+
+	// Labels the weak components with a search that follows edges both ways.
+	void BuildWeakComponents(const FAI_NavGraph& Graph);
+
+	// Works out which strong components every strong component can reach.
+	void BuildReachabilityTable(const FAI_NavGraph& Graph);
+
+	// Sorts the nodes by their label, and stores where each label's nodes begin.
+	static void GroupNodes(const TArray<int32>& Labels, int32 NumLabels, TArray<int32>& OutNodes, TArray<int32>& OutOffsets);
+
+	// Checks if a strong component can reach another.
+	bool CanReach(int32 FromComponent, int32 ToComponent) const { return (ReachableComponents[FromComponent * TableWords + (ToComponent >> 6)] >> (ToComponent & 63)) & 1; }
+
+	// The strong component of each node.
+	TArray<int32> StrongComponents;
+
+	// The nodes sorted by strong component.
+	TArray<int32> StrongComponentNodes;
+
+	// The index of the first node of each strong component, with one extra entry at the end holding the number of nodes.
+	TArray<int32> StrongComponentOffsets;
+
+	// The weak component of each node.
+	TArray<int32> WeakComponents;
+
+	// The nodes sorted by weak component.
+	TArray<int32> WeakComponentNodes;
+
+	// The index of the first node of each weak component, with one extra entry at the end holding the number of nodes.
+	TArray<int32> WeakComponentOffsets;
+
+	// One row of bits per strong component, with a bit set for every strong component it can reach.
+	TArray<uint64> ReachableComponents;
+
+	// How many nodes each strong component can reach, including its own.
+	TArray<int32> ReachableNodeCounts;
+
+	// The number of 64 bit words in each row of the reachability table.
+	int32 TableWords = 0;
+};
@@ -0,0 +1,480 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_HierarchicalGraph.h"
+#include "AI_NavGraph.h"
+#include "AI_PathSearch.h"
+#include "Algo/Reverse.h"
+#include "Async/ParallelFor.h"
+
+void FAI_HierarchicalPath::Reset()
+{
+	Waypoints.Reset();
+	NextWaypoint = 0;
+	GraphVersion = 0;
+}
+
+// Nodes are put into clusters by the square of the map they stand in. A node becomes an entrance when one of its edges
+// crosses into another cluster. The abstract graph then holds the crossing edges, plus an edge between every pair of
+// entrances of the same cluster that are connected inside it.
+void FAI_HierarchicalGraph::Build(const FAI_NavGraph& Graph, float InClusterSize)
+{
+	Empty();
+
+	const int32 NodeCount = Graph.NumNodes();
+	if (NodeCount == 0)
+	{
+		return;
+	}
+
+	ClusterSize = FMath::Max(InClusterSize, 1.0f);
+
+	// Give each square of the map that holds a node its own cluster.
+	NodeClusters.SetNumUninitialized(NodeCount);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		NodeClusters[Node] = FindOrAddCluster(Graph, Node);
+	}
+
+	BuildAbstractGraph(Graph, TBitArray<>(true, CellClusters.Num()), FAI_HierarchicalGraph());
+}
+
+// Checks if a node has the same edges, in the same order and with the same lengths, in two versions of the graph.
+static bool HasSameEdges(const TArray<int32>& OldOffsets, const TArray<int32>& OldNodes, const TArray<float>& OldLengths,
+	const TArray<int32>& Offsets, const TArray<int32>& Nodes, const TArray<float>& Lengths, int32 Node)
+{
+	const int32 OldFirstEdge = OldOffsets[Node];
+	const int32 FirstEdge = Offsets[Node];
+	const int32 NumEdges = Offsets[Node + 1] - FirstEdge;
+	if (OldOffsets[Node + 1] - OldFirstEdge != NumEdges)
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < NumEdges; Index++)
+	{
+		if (OldNodes[OldFirstEdge + Index] != Nodes[FirstEdge + Index] || OldLengths[OldFirstEdge + Index] != Lengths[FirstEdge + Index])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Nodes keep their clusters, and new nodes are put into clusters the same way as when building. The entrances of a cluster and the paths
+// between them only depend on the edges of its own nodes. An edge that was added or removed shows up on both of its nodes,
+// in the edges of one and the arriving edges of the other, so every cluster it touches is searched again.
+void FAI_HierarchicalGraph::Update(const FAI_NavGraph& OldGraph, const FAI_NavGraph& Graph, float InClusterSize)
+{
+	const int32 OldNodeCount = OldGraph.NumNodes();
+	const int32 NodeCount = Graph.NumNodes();
+	if (!IsBuiltFor(OldGraph.Version) || ClusterSize != FMath::Max(InClusterSize, 1.0f) || Graph.LayoutVersion != OldGraph.LayoutVersion || NodeCount < OldNodeCount)
+	{
+		Build(Graph, InClusterSize);
+		return;
+	}
+
+	// A node that moved could belong to another cluster, which the entrances of every cluster around it would need to know about.
+	for (int32 Node = 0; Node < OldNodeCount; Node++)
+	{
+		if (OldGraph.PositionsX[Node] != Graph.PositionsX[Node] || OldGraph.PositionsY[Node] != Graph.PositionsY[Node])
+		{
+			Build(Graph, InClusterSize);
+			return;
+		}
+	}
+
+	FAI_HierarchicalGraph Previous = MoveTemp(*this);
+	ClusterSize = Previous.ClusterSize;
+	CellClusters = MoveTemp(Previous.CellClusters);
+	NodeClusters = MoveTemp(Previous.NodeClusters);
+
+	NodeClusters.SetNumUninitialized(NodeCount);
+	for (int32 Node = OldNodeCount; Node < NodeCount; Node++)
+	{
+		NodeClusters[Node] = FindOrAddCluster(Graph, Node);
+	}
+
+	TBitArray<> SearchedClusters(false, CellClusters.Num());
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		if (Node >= OldNodeCount
+			|| !HasSameEdges(OldGraph.EdgeOffsets, OldGraph.Neighbours, OldGraph.EdgeLengths, Graph.EdgeOffsets, Graph.Neighbours, Graph.EdgeLengths, Node)
+			|| !HasSameEdges(OldGraph.ReverseEdgeOffsets, OldGraph.ReverseNeighbours, OldGraph.ReverseEdgeLengths,
+				Graph.ReverseEdgeOffsets, Graph.ReverseNeighbours, Graph.ReverseEdgeLengths, Node))
+		{
+			SearchedClusters[NodeClusters[Node]] = true;
+		}
+	}
+
+	BuildAbstractGraph(Graph, SearchedClusters, Previous);
+	UE_LOG(LogTemp, Display, TEXT("Searched %d of %d clusters again"), SearchedClusters.CountSetBits(), NumClusters())
+}
+
+int32 FAI_HierarchicalGraph::FindOrAddCluster(const FAI_NavGraph& Graph, int32 Node)
+{
+	const FIntPoint Cell(FMath::FloorToInt(Graph.PositionsX[Node] / ClusterSize), FMath::FloorToInt(Graph.PositionsY[Node] / ClusterSize));
+	return CellClusters.FindOrAdd(Cell, CellClusters.Num());
+}
+
+// The entrances and the edges between clusters are cheap to find again from the edges of the graph, so only the searches
+// inside the clusters are worth keeping.
+void FAI_HierarchicalGraph::BuildAbstractGraph(const FAI_NavGraph& Graph, const TBitArray<>& SearchedClusters, const FAI_HierarchicalGraph& Previous)
+{
+	const int32 NodeCount = Graph.NumNodes();
+	const int32 ClusterCount = CellClusters.Num();
+
+	// Find the entrances, which are the nodes on either end of an edge between two clusters.
+	TArray<int32> NodeEntrances;
+	NodeEntrances.Init(INDEX_NONE, NodeCount);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+		{
+			const int32 AdjacentNode = Graph.Neighbours[Edge];
+			if (NodeClusters[Node] != NodeClusters[AdjacentNode])
+			{
+				if (NodeEntrances[Node] == INDEX_NONE)
+				{
+					NodeEntrances[Node] = EntranceNodes.Add(Node);
+				}
+				if (NodeEntrances[AdjacentNode] == INDEX_NONE)
+				{
+					NodeEntrances[AdjacentNode] = EntranceNodes.Add(AdjacentNode);
+				}
+			}
+		}
+	}
+	const int32 EntranceCount = EntranceNodes.Num();
+
+	// Group the entrances by cluster.
+	ClusterEntranceOffsets.SetNumZeroed(ClusterCount + 1);
+	for (const int32 EntranceNode : EntranceNodes)
+	{
+		ClusterEntranceOffsets[NodeClusters[EntranceNode] + 1]++;
+	}
+	for (int32 Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		ClusterEntranceOffsets[Cluster + 1] += ClusterEntranceOffsets[Cluster];
+	}
+	TArray<int32> NextClusterEntrance(ClusterEntranceOffsets.GetData(), ClusterCount);
+	ClusterEntrances.SetNumUninitialized(EntranceCount);
+	for (int32 Entrance = 0; Entrance < EntranceCount; Entrance++)
+	{
+		ClusterEntrances[NextClusterEntrance[NodeClusters[EntranceNodes[Entrance]]]++] = Entrance;
+	}
+
+	// Add the edges that cross between clusters.
+	TArray<TArray<TPair<int32, float>>> EntranceEdges;
+	EntranceEdges.SetNum(EntranceCount);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+		{
+			const int32 AdjacentNode = Graph.Neighbours[Edge];
+			if (NodeClusters[Node] != NodeClusters[AdjacentNode])
+			{
+				EntranceEdges[NodeEntrances[Node]].Emplace(NodeEntrances[AdjacentNode], Graph.EdgeLengths[Edge]);
+			}
+		}
+	}
+
+	// The entrance each node was in the previous abstract graph, for the clusters that are not searched again.
+	TArray<int32> PreviousNodeEntrances;
+	PreviousNodeEntrances.Init(INDEX_NONE, Previous.NodeClusters.Num());
+	for (int32 Entrance = 0; Entrance < Previous.EntranceNodes.Num(); Entrance++)
+	{
+		PreviousNodeEntrances[Previous.EntranceNodes[Entrance]] = Entrance;
+	}
+
+	// Add the edges between the entrances of each cluster. Every entrance belongs to one cluster,
+	// so the clusters can be searched on different worker threads without touching the same edge lists.
+	ParallelFor(ClusterCount, [this, &Graph, &EntranceEdges, &SearchedClusters, &Previous, &PreviousNodeEntrances, &NodeEntrances](int32 Cluster)
+	{
+		// A cluster that is not searched again has the same entrances as before, so its edges are copied over with the entrances numbered again.
+		// The edges to other clusters were added above, so only the edges inside the cluster are copied.
+		if (!SearchedClusters[Cluster])
+		{
+			for (int32 Index = ClusterEntranceOffsets[Cluster]; Index < ClusterEntranceOffsets[Cluster + 1]; Index++)
+			{
+				const int32 Entrance = ClusterEntrances[Index];
+				const int32 PreviousEntrance = PreviousNodeEntrances[EntranceNodes[Entrance]];
+				for (int32 Edge = Previous.AbstractEdgeOffsets[PreviousEntrance]; Edge < Previous.AbstractEdgeOffsets[PreviousEntrance + 1]; Edge++)
+				{
+					const int32 OtherNode = Previous.EntranceNodes[Previous.AbstractNeighbours[Edge]];
+					if (NodeClusters[OtherNode] == Cluster)
+					{
+						EntranceEdges[Entrance].Emplace(NodeEntrances[OtherNode], Previous.AbstractEdgeCosts[Edge]);
+					}
+				}
+			}
+			return;
+		}
+
+		FAI_SearchContext Context;
+
+		for (int32 Index = ClusterEntranceOffsets[Cluster]; Index < ClusterEntranceOffsets[Cluster + 1]; Index++)
+		{
+			const int32 Entrance = ClusterEntrances[Index];
+			SearchInCluster(Graph, EntranceNodes[Entrance], INDEX_NONE, false, Context);
+
+			for (int32 OtherIndex = ClusterEntranceOffsets[Cluster]; OtherIndex < ClusterEntranceOffsets[Cluster + 1]; OtherIndex++)
+			{
+				const int32 OtherEntrance = ClusterEntrances[OtherIndex];
+				const int32 OtherNode = EntranceNodes[OtherEntrance];
+				if (OtherEntrance != Entrance && Context.IsVisited(OtherNode) && Context.GScores[OtherNode] < UE_MAX_FLT)
+				{
+					EntranceEdges[Entrance].Emplace(OtherEntrance, Context.GScores[OtherNode]);
+				}
+			}
+		}
+	});
+
+	// Lay the abstract edges out one entrance after another.
+	AbstractEdgeOffsets.SetNumUninitialized(EntranceCount + 1);
+	for (int32 Entrance = 0; Entrance < EntranceCount; Entrance++)
+	{
+		AbstractEdgeOffsets[Entrance] = AbstractNeighbours.Num();
+		for (const TPair<int32, float>& EntranceEdge : EntranceEdges[Entrance])
+		{
+			AbstractNeighbours.Add(EntranceEdge.Key);
+			AbstractEdgeCosts.Add(EntranceEdge.Value);
+		}
+	}
+	AbstractEdgeOffsets[EntranceCount] = AbstractNeighbours.Num();
+
+	BuiltGraphVersion = Graph.Version;
+}
+
+void FAI_HierarchicalGraph::Empty()
+{
+	CellClusters.Reset();
+	NodeClusters.Reset();
+	EntranceNodes.Reset();
+	ClusterEntranceOffsets.Reset();
+	ClusterEntrances.Reset();
+	AbstractEdgeOffsets.Reset();
+	AbstractNeighbours.Reset();
+	AbstractEdgeCosts.Reset();
+	BuiltGraphVersion = 0;
+}
+
+// The start and end nodes are joined to the entrances of their own clusters, then the abstract graph is searched with A*.
+bool FAI_HierarchicalGraph::FindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, FAI_SearchContext& Context, FAI_HierarchicalPath& OutPath) const
+{
+	OutPath.Reset();
+	OutPath.GraphVersion = BuiltGraphVersion;
+
+	const int32 StartCluster = NodeClusters[StartNode];
+	const int32 EndCluster = NodeClusters[EndNode];
+
+	// If both nodes are in the same cluster and connected inside it, then there is nothing to search at the cluster level.
+	if (StartCluster == EndCluster && SearchInCluster(Graph, StartNode, EndNode, false, Context))
+	{
+		OutPath.Waypoints.Add(StartNode);
+		OutPath.Waypoints.Add(EndNode);
+		return true;
+	}
+
+	// Find the cost from the start node to each entrance of its cluster.
+	TArray<TPair<int32, float>, TInlineAllocator<32>> StartEdges;
+	SearchInCluster(Graph, StartNode, INDEX_NONE, false, Context);
+	for (int32 Index = ClusterEntranceOffsets[StartCluster]; Index < ClusterEntranceOffsets[StartCluster + 1]; Index++)
+	{
+		const int32 EntranceNode = EntranceNodes[ClusterEntrances[Index]];
+		if (Context.IsVisited(EntranceNode) && Context.GScores[EntranceNode] < UE_MAX_FLT)
+		{
+			StartEdges.Emplace(ClusterEntrances[Index], Context.GScores[EntranceNode]);
+		}
+	}
+
+	// Find the cost from each entrance of the end node's cluster to the end node.
+	TArray<TPair<int32, float>, TInlineAllocator<32>> EndEdges;
+	SearchInCluster(Graph, EndNode, INDEX_NONE, true, Context);
+	for (int32 Index = ClusterEntranceOffsets[EndCluster]; Index < ClusterEntranceOffsets[EndCluster + 1]; Index++)
+	{
+		const int32 EntranceNode = EntranceNodes[ClusterEntrances[Index]];
+		if (Context.IsVisited(EntranceNode) && Context.GScores[EntranceNode] < UE_MAX_FLT)
+		{
+			EndEdges.Emplace(ClusterEntrances[Index], Context.GScores[EntranceNode]);
+		}
+	}
+
+	// The start and end nodes are added to the abstract graph after the entrances.
+	const int32 EntranceCount = EntranceNodes.Num();
+	const int32 StartIndex = EntranceCount;
+	const int32 EndIndex = EntranceCount + 1;
+
+	Context.Begin(EntranceCount + 2);
+	Context.Visit(StartIndex, 0.0f, Graph.GetDistance(StartNode, EndNode));
+	Context.OpenSet.PushOrDecrease(StartIndex, Context.HScores[StartIndex]);
+
+	auto Relax = [&Context, &Graph, this, EndIndex, EndNode](int32 CurrentIndex, int32 AdjacentIndex, float Cost)
+	{
+		const float TentativeGScore = Context.GScores[CurrentIndex] + Cost;
+		if (!Context.IsVisited(AdjacentIndex))
+		{
+			const float HScore = AdjacentIndex == EndIndex ? 0.0f : Graph.GetDistance(EntranceNodes[AdjacentIndex], EndNode);
+			Context.Visit(AdjacentIndex, UE_MAX_FLT, HScore);
+		}
+		if (TentativeGScore < Context.GScores[AdjacentIndex])
+		{
+			Context.CameFrom[AdjacentIndex] = CurrentIndex;
+			Context.GScores[AdjacentIndex] = TentativeGScore;
+			Context.OpenSet.PushOrDecrease(AdjacentIndex, TentativeGScore + Context.HScores[AdjacentIndex]);
+		}
+	};
+
+	bool bFoundPath = false;
+	while (!Context.OpenSet.IsEmpty())
+	{
+		const int32 CurrentIndex = Context.OpenSet.Pop();
+		if (CurrentIndex == EndIndex)
+		{
+			bFoundPath = true;
+			break;
+		}
+
+		if (CurrentIndex == StartIndex)
+		{
+			for (const TPair<int32, float>& StartEdge : StartEdges)
+			{
+				Relax(CurrentIndex, StartEdge.Key, StartEdge.Value);
+			}
+			continue;
+		}
+
+		for (int32 Edge = AbstractEdgeOffsets[CurrentIndex]; Edge < AbstractEdgeOffsets[CurrentIndex + 1]; Edge++)
+		{
+			Relax(CurrentIndex, AbstractNeighbours[Edge], AbstractEdgeCosts[Edge]);
+		}
+
+		// Entrances of the end node's cluster can also step straight to the end node.
+		if (NodeClusters[EntranceNodes[CurrentIndex]] == EndCluster)
+		{
+			for (const TPair<int32, float>& EndEdge : EndEdges)
+			{
+				if (EndEdge.Key == CurrentIndex)
+				{
+					Relax(CurrentIndex, EndIndex, EndEdge.Value);
+				}
+			}
+		}
+	}
+
+	if (!bFoundPath)
+	{
+		return false;
+	}
+
+	// Follow the came from links back to the start, turning abstract indices back into graph nodes.
+	for (int32 Index = EndIndex; Index != INDEX_NONE; Index = Context.CameFrom[Index])
+	{
+		const int32 Node = Index == EndIndex ? EndNode : (Index == StartIndex ? StartNode : EntranceNodes[Index]);
+
+		// The start or end node may also be an entrance, so it is only added once.
+		if (OutPath.Waypoints.IsEmpty() || OutPath.Waypoints.Last() != Node)
+		{
+			OutPath.Waypoints.Add(Node);
+		}
+	}
+	Algo::Reverse(OutPath.Waypoints);
+
+	return true;
+}
+
+// Waypoints inside the same cluster are joined by a search inside that cluster. Waypoints in different clusters are
+// joined by a single edge, and crossing that edge ends the refinement.
+bool FAI_HierarchicalGraph::RefineNextCluster(const FAI_NavGraph& Graph, FAI_HierarchicalPath& Path, FAI_SearchContext& Context, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	if (Path.GraphVersion != BuiltGraphVersion || !Path.HasRemainingSegments())
+	{
+		return false;
+	}
+
+	TArray<int32, TInlineAllocator<64>> RefinedNodes;
+	RefinedNodes.Add(Path.Waypoints[Path.NextWaypoint]);
+
+	while (Path.HasRemainingSegments())
+	{
+		const int32 FromNode = Path.Waypoints[Path.NextWaypoint];
+		const int32 ToNode = Path.Waypoints[Path.NextWaypoint + 1];
+		Path.NextWaypoint++;
+
+		if (NodeClusters[FromNode] != NodeClusters[ToNode])
+		{
+			RefinedNodes.Add(ToNode);
+			break;
+		}
+
+		if (!SearchInCluster(Graph, FromNode, ToNode, false, Context))
+		{
+			return false;
+		}
+
+		// The came from links go backwards, so the nodes of this part are added in reverse and then flipped around.
+		const int32 FirstNewNode = RefinedNodes.Num();
+		for (int32 Node = ToNode; Node != FromNode; Node = Context.CameFrom[Node])
+		{
+			RefinedNodes.Add(Node);
+		}
+		Algo::Reverse(MakeArrayView(RefinedNodes.GetData() + FirstNewNode, RefinedNodes.Num() - FirstNewNode));
+	}
+
+	// Paths go from their end back to their start.
+	OutNodes.Reserve(RefinedNodes.Num());
+	for (int32 Index = RefinedNodes.Num() - 1; Index >= 0; Index--)
+	{
+		OutNodes.Add(RefinedNodes[Index]);
+	}
+
+	return true;
+}
+
+// The same search as FAI_SearchContext::FindPath, but edges leaving the cluster are ignored.
+bool FAI_HierarchicalGraph::SearchInCluster(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, bool bBackwards, FAI_SearchContext& Context) const
+{
+	const int32 Cluster = NodeClusters[StartNode];
+
+	const TArray<int32>& Offsets = bBackwards ? Graph.ReverseEdgeOffsets : Graph.EdgeOffsets;
+	const TArray<int32>& EdgeNodes = bBackwards ? Graph.ReverseNeighbours : Graph.Neighbours;
+	const TArray<float>& Lengths = bBackwards ? Graph.ReverseEdgeLengths : Graph.EdgeLengths;
+
+	Context.Begin(Graph.NumNodes());
+	Context.Visit(StartNode, 0.0f, EndNode != INDEX_NONE ? Graph.GetDistance(StartNode, EndNode) : 0.0f);
+	Context.OpenSet.PushOrDecrease(StartNode, Context.HScores[StartNode]);
+
+	while (!Context.OpenSet.IsEmpty())
+	{
+		const int32 CurrentNode = Context.OpenSet.Pop();
+		if (CurrentNode == EndNode)
+		{
+			return true;
+		}
+
+		for (int32 Edge = Offsets[CurrentNode]; Edge < Offsets[CurrentNode + 1]; Edge++)
+		{
+			const int32 AdjacentNode = EdgeNodes[Edge];
+			if (NodeClusters[AdjacentNode] != Cluster)
+			{
+				continue;
+			}
+
+			const float TentativeGScore = Context.GScores[CurrentNode] + Lengths[Edge];
+			if (!Context.IsVisited(AdjacentNode))
+			{
+				Context.Visit(AdjacentNode, UE_MAX_FLT, EndNode != INDEX_NONE ? Graph.GetDistance(AdjacentNode, EndNode) : 0.0f);
+			}
+
+			if (TentativeGScore < Context.GScores[AdjacentNode])
+			{
+				Context.CameFrom[AdjacentNode] = CurrentNode;
+				Context.GScores[AdjacentNode] = TentativeGScore;
+				Context.OpenSet.PushOrDecrease(AdjacentNode, TentativeGScore + Context.HScores[AdjacentNode]);
+			}
+		}
+	}
+
+	return false;
+}
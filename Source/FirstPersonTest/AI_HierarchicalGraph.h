@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+struct FAI_SearchContext;
+
+// A path found at the cluster level. It lists the nodes where the path crosses from one cluster to the next,
+// and is turned into a detailed path one cluster at a time as the agent walks it.
+struct FIRSTPERSONTEST_API FAI_HierarchicalPath
+{
+	// Forgets the path.
+	void Reset();
+
+	// Checks if there is still part of the path that has not been refined.
+	bool HasRemainingSegments() const { return NextWaypoint < Waypoints.Num() - 1; }
+
+	// The nodes the path passes through at the cluster level, from the start node to the end node.
+	TArray<int32> Waypoints;
+
+	// The first waypoint the next refinement starts from.
+	int32 NextWaypoint = 0;
+
+	// The version of the graph the path was found on.
+	uint32 GraphVersion = 0;
+};
+
+// The navigation graph split into square clusters, with a small abstract graph between the entrances of the clusters.
+// Long paths are searched on the abstract graph first, which only holds the nodes where clusters connect.
+class FIRSTPERSONTEST_API FAI_HierarchicalGraph
+{
+public:
+
+	// Splits the graph into clusters and works out the cost between every pair of entrances of each cluster.
+	void Build(const FAI_NavGraph& Graph, float InClusterSize);
+
+	// Brings the clusters up to date with a new version of the graph they were built for, whose nodes kept their indices.
+	// Only the clusters holding a node whose edges changed are searched again. Anything else, or a new cluster size, is built from scratch.
+	void Update(const FAI_NavGraph& OldGraph, const FAI_NavGraph& Graph, float InClusterSize);
+
+	// Removes the clusters and the abstract graph.
+	void Empty();
+
+	// Checks if the clusters were built for a version of the navigation graph.
+	bool IsBuiltFor(uint32 GraphVersion) const { return NodeClusters.Num() > 0 && BuiltGraphVersion == GraphVersion; }
+
+	// Gets the number of clusters.
+	int32 NumClusters() const { return ClusterEntranceOffsets.Num() > 0 ? ClusterEntranceOffsets.Num() - 1 : 0; }
+
+	// Gets the number of entrance nodes in the abstract graph.
+	int32 NumEntrances() const { return EntranceNodes.Num(); }
+
+	// Finds a path between two nodes at the cluster level. Returns false if there is no path.
+	bool FindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, FAI_SearchContext& Context, FAI_HierarchicalPath& OutPath) const;
+
+	// Turns the next part of a path into nodes, up to and including the first node of the next cluster.
+	// The nodes go from the end of that part back to its start, like every other path. Returns false if the path is used up or out of date.
+	bool RefineNextCluster(const FAI_NavGraph& Graph, FAI_HierarchicalPath& Path, FAI_SearchContext& Context, TArray<int32>& OutNodes) const;
+
+private:
+
+	// Gets the cluster of the square of the map a node stands in, giving the square a new cluster if it has none yet.
+	int32 FindOrAddCluster(const FAI_NavGraph& Graph, int32 Node);
+
+	// Finds the entrances and lays out the abstract graph for the clusters the nodes have been put in.
+	// The costs between the entrances of a cluster are only searched for if it is one of SearchedClusters, and are taken from Previous otherwise.
+	void BuildAbstractGraph(const FAI_NavGraph& Graph, const TBitArray<>& SearchedClusters, const FAI_HierarchicalGraph& Previous);
+
+	// Searches the nodes of the start node's cluster. Without an end node, every node of the cluster is reached.
+	// Searching backwards gives the distances to the start node instead of from it. Returns false if the end node was not reached.
+	bool SearchInCluster(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, bool bBackwards, FAI_SearchContext& Context) const;
+
+	// The cluster of each square of the map that holds a node.
+	TMap<FIntPoint, int32> CellClusters;
+
+	// The cluster each node belongs to.
+	TArray<int32> NodeClusters;
+
+	// The graph node of each entrance.
+	TArray<int32> EntranceNodes;
+
+	// The index of the first entrance of each cluster, with one extra entry at the end holding the number of entrances.
+	TArray<int32> ClusterEntranceOffsets;
+
+	// The entrances of every cluster, one cluster after another.
+	TArray<int32> ClusterEntrances;
+
+	// The index of the first abstract edge of each entrance, with one extra entry at the end holding the number of edges.
+	TArray<int32> AbstractEdgeOffsets;
+
+	// The entrance each abstract edge leads to.
+	TArray<int32> AbstractNeighbours;
+
+	// The cost of each abstract edge.
+	TArray<float> AbstractEdgeCosts;
+
+	// The width and depth of each cluster.
+	float ClusterSize = 0.0f;
+
+	// The version of the graph the clusters were built for.
+	uint32 BuiltGraphVersion = 0;
+};
@@ -0,0 +1,238 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_IncrementalSearch.h"
+#include "AI_NavGraph.h"
+
+// The tree only has to be grown from scratch when the graph has changed or the agent has walked off the path.
+// Otherwise a moving goal only re-keys the open set, because the costs from the root do not depend on the goal.
+bool FAI_IncrementalSearch::Replan(const FAI_NavGraph& Graph, int32 NewStartNode, int32 NewGoalNode)
+{
+	LastExpansions = 0;
+
+	if (!IsBuiltFor(Graph.Version))
+	{
+		GoalNode = NewGoalNode;
+		Restart(Graph, NewStartNode);
+	}
+	else if (NewGoalNode != GoalNode)
+	{
+		GoalNode = NewGoalNode;
+		OpenSet.UpdateAllKeys([this, &Graph](int32 Node) { return CalculateKey(Graph, Node); });
+	}
+	ComputeShortestPath(Graph);
+
+	// If the agent is no longer on the path from the root, then the tree cannot give it a path, so grow a new one from the agent.
+	if (NewStartNode != RootNode && !IsOnPath(NewStartNode))
+	{
+		Restart(Graph, NewStartNode);
+		ComputeShortestPath(Graph);
+	}
+	StartNode = NewStartNode;
+
+	return GetGScore(GoalNode) != UE_MAX_FLT;
+}
+
+// The edges are the same as before, so only the nodes they lead to need their costs worked out again.
+void FAI_IncrementalSearch::UpdateEdges(const FAI_NavGraph& Graph, TArrayView<const int32> ChangedEdges)
+{
+	if (RootNode == INDEX_NONE)
+	{
+		return;
+	}
+
+	GraphVersion = Graph.Version;
+	for (const int32 Edge : ChangedEdges)
+	{
+		UpdateNode(Graph, Graph.Neighbours[Edge]);
+	}
+
+	// The new graph may estimate distances differently, so the keys of the open set are worked out again.
+	OpenSet.UpdateAllKeys([this, &Graph](int32 Node) { return CalculateKey(Graph, Node); });
+}
+
+// Follows the parents back from the goal until it reaches the agent's node.
+bool FAI_IncrementalSearch::GetPath(TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	if (RootNode == INDEX_NONE || GetGScore(GoalNode) == UE_MAX_FLT)
+	{
+		return false;
+	}
+
+	int32 CurrentNode = GoalNode;
+	OutNodes.Add(CurrentNode);
+
+	while (CurrentNode != StartNode)
+	{
+		CurrentNode = Parents[CurrentNode];
+
+		// This only happens if the agent is not on the path, which Replan never leaves it in.
+		if (CurrentNode == INDEX_NONE || OutNodes.Num() > Parents.Num())
+		{
+			OutNodes.Reset();
+			return false;
+		}
+		OutNodes.Add(CurrentNode);
+	}
+
+	return true;
+}
+
+void FAI_IncrementalSearch::Reset()
+{
+	OpenSet.Empty();
+	RootNode = INDEX_NONE;
+	StartNode = INDEX_NONE;
+	GoalNode = INDEX_NONE;
+	LastExpansions = 0;
+}
+
+// Grows the arrays if the graph got bigger and moves on to the next generation, like FAI_SearchContext::Begin.
+void FAI_IncrementalSearch::Restart(const FAI_NavGraph& Graph, int32 NewRootNode)
+{
+	const int32 NodeCount = Graph.NumNodes();
+	if (Generations.Num() < NodeCount)
+	{
+		GScores.SetNumUninitialized(NodeCount);
+		RhsScores.SetNumUninitialized(NodeCount);
+		Parents.SetNumUninitialized(NodeCount);
+		Generations.SetNumZeroed(NodeCount);
+	}
+	OpenSet.Reserve(NodeCount);
+	OpenSet.Empty();
+
+	++Generation;
+	if (Generation == 0)
+	{
+		FMemory::Memzero(Generations.GetData(), Generations.Num() * sizeof(uint32));
+		Generation = 1;
+	}
+
+	RootNode = NewRootNode;
+	GraphVersion = Graph.Version;
+
+	Touch(RootNode);
+	RhsScores[RootNode] = 0.0f;
+	UpdateOpenSet(Graph, RootNode);
+}
+
+// Stops once the goal's cost agrees with its incoming edges and no open node could still lead to a shorter path.
+void FAI_IncrementalSearch::ComputeShortestPath(const FAI_NavGraph& Graph)
+{
+	while (!OpenSet.IsEmpty() && (OpenSet.TopKey() < CalculateKey(Graph, GoalNode) || GetRhsScore(GoalNode) != GetGScore(GoalNode)))
+	{
+		const int32 CurrentNode = OpenSet.Pop();
+		LastExpansions++;
+
+		// The node got cheaper, so accept the new cost and pass it on to the nodes after it.
+		if (GScores[CurrentNode] > RhsScores[CurrentNode])
+		{
+			GScores[CurrentNode] = RhsScores[CurrentNode];
+
+			for (int32 Edge = Graph.GetFirstEdge(CurrentNode); Edge < Graph.GetLastEdge(CurrentNode); Edge++)
+			{
+				const int32 AdjacentNode = Graph.Neighbours[Edge];
+				const float TentativeScore = GScores[CurrentNode] + Graph.EdgeLengths[Edge];
+
+				Touch(AdjacentNode);
+				if (AdjacentNode != RootNode && TentativeScore < RhsScores[AdjacentNode])
+				{
+					RhsScores[AdjacentNode] = TentativeScore;
+					Parents[AdjacentNode] = CurrentNode;
+					UpdateOpenSet(Graph, AdjacentNode);
+				}
+			}
+		}
+
+		// The node got more expensive, so forget its cost. It and every node that was reached through it are worked out again.
+		else
+		{
+			GScores[CurrentNode] = UE_MAX_FLT;
+			UpdateNode(Graph, CurrentNode);
+
+			for (int32 Edge = Graph.GetFirstEdge(CurrentNode); Edge < Graph.GetLastEdge(CurrentNode); Edge++)
+			{
+				const int32 AdjacentNode = Graph.Neighbours[Edge];
+				if (Generations[AdjacentNode] == Generation && Parents[AdjacentNode] == CurrentNode)
+				{
+					UpdateNode(Graph, AdjacentNode);
+				}
+			}
+		}
+	}
+}
+
+// The cost of a node is the cheapest of the costs of the nodes before it plus the edge from them.
+void FAI_IncrementalSearch::UpdateNode(const FAI_NavGraph& Graph, int32 Node)
+{
+	Touch(Node);
+
+	if (Node != RootNode)
+	{
+		RhsScores[Node] = UE_MAX_FLT;
+		Parents[Node] = INDEX_NONE;
+
+		for (int32 Edge = Graph.GetFirstReverseEdge(Node); Edge < Graph.GetLastReverseEdge(Node); Edge++)
+		{
+			const int32 PreviousNode = Graph.ReverseNeighbours[Edge];
+			const float PreviousScore = GetGScore(PreviousNode);
+			if (PreviousScore != UE_MAX_FLT && PreviousScore + Graph.ReverseEdgeLengths[Edge] < RhsScores[Node])
+			{
+				RhsScores[Node] = PreviousScore + Graph.ReverseEdgeLengths[Edge];
+				Parents[Node] = PreviousNode;
+			}
+		}
+	}
+
+	UpdateOpenSet(Graph, Node);
+}
+
+void FAI_IncrementalSearch::UpdateOpenSet(const FAI_NavGraph& Graph, int32 Node)
+{
+	if (GScores[Node] != RhsScores[Node])
+	{
+		OpenSet.PushOrUpdate(Node, CalculateKey(Graph, Node));
+	}
+	else
+	{
+		OpenSet.Remove(Node);
+	}
+}
+
+// The smaller of the two costs plus the estimated distance to the goal.
+float FAI_IncrementalSearch::CalculateKey(const FAI_NavGraph& Graph, int32 Node) const
+{
+	const float Score = FMath::Min(GetGScore(Node), GetRhsScore(Node));
+	return Score == UE_MAX_FLT ? UE_MAX_FLT : Score + Graph.GetHeuristic(Node, GoalNode);
+}
+
+void FAI_IncrementalSearch::Touch(int32 Node)
+{
+	if (Generations[Node] != Generation)
+	{
+		GScores[Node] = UE_MAX_FLT;
+		RhsScores[Node] = UE_MAX_FLT;
+		Parents[Node] = INDEX_NONE;
+		Generations[Node] = Generation;
+	}
+}
+
+bool FAI_IncrementalSearch::IsOnPath(int32 Node) const
+{
+	if (GetGScore(GoalNode) == UE_MAX_FLT)
+	{
+		return false;
+	}
+
+	int32 CurrentNode = GoalNode;
+	for (int32 Step = 0; CurrentNode != INDEX_NONE && Step < Parents.Num(); Step++)
+	{
+		if (CurrentNode == Node)
+		{
+			return true;
+		}
+		CurrentNode = Parents[CurrentNode];
+	}
+	return false;
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI_PathSearch.h"
+
+struct FAI_NavGraph;
+
+// Identifies an incremental search owned by the pathfinding subsystem
+struct FIRSTPERSONTEST_API FAI_IncrementalSearchHandle
+{
+	// The id of the search. Zero means no search.
+	uint32 Id = 0;
+
+	// Checks if this handle belongs to a search.
+	bool IsValid() const { return Id != 0; }
+
+	// Clears the handle so it no longer belongs to a search.
+	void Invalidate() { Id = 0; }
+
+	bool operator==(const FAI_IncrementalSearchHandle& Other) const { return Id == Other.Id; }
+	bool operator!=(const FAI_IncrementalSearchHandle& Other) const { return Id != Other.Id; }
+};
+
+// A Lifelong Planning A* search that keeps its state between calls, for an agent that keeps chasing a moving goal.
+// The search grows a tree of shortest paths from a root node. When the goal moves, only the open nodes are re-keyed
+// and the search carries on from where it stopped. When edge costs change, only the nodes whose cost went out of date are searched again.
+// The tree is kept for as long as the agent stays on the path it is following, and restarted from the agent once it leaves it.
+class FIRSTPERSONTEST_API FAI_IncrementalSearch
+{
+public:
+
+	// Brings the shortest path from a start node to a goal node up to date, reusing as much of the last search as it can.
+	// Returns false if the goal cannot be reached.
+	bool Replan(const FAI_NavGraph& Graph, int32 StartNode, int32 NewGoalNode);
+
+	// Tells the search that the lengths of some edges have changed in a new version of the graph with the same nodes and edges.
+	// The nodes the edges lead to are searched again on the next call to Replan.
+	void UpdateEdges(const FAI_NavGraph& Graph, TArrayView<const int32> ChangedEdges);
+
+	// Gets the nodes of the path found by the last call to Replan, from the goal back to the start node.
+	// Returns false if the goal cannot be reached.
+	bool GetPath(TArray<int32>& OutNodes) const;
+
+	// Forgets the search so the next call to Replan starts from scratch.
+	void Reset();
+
+	// Gets the node the search was last asked to reach.
+	int32 GetGoalNode() const { return GoalNode; }
+
+	// Checks if the search was run on a version of the navigation graph.
+	bool IsBuiltFor(uint32 InGraphVersion) const { return RootNode != INDEX_NONE && GraphVersion == InGraphVersion; }
+
+	// Gets how many nodes the last call to Replan expanded.
+	int32 GetLastExpansions() const { return LastExpansions; }
+
+private:
+
+	// Starts a new tree from a root node.
+	void Restart(const FAI_NavGraph& Graph, int32 NewRootNode);
+
+	// Expands nodes until the goal's cost is known to be the shortest.
+	void ComputeShortestPath(const FAI_NavGraph& Graph);
+
+	// Works out a node's cost from its incoming edges, then puts it in or takes it out of the open set.
+	void UpdateNode(const FAI_NavGraph& Graph, int32 Node);
+
+	// Puts a node in the open set if its two costs disagree, or takes it out if they agree.
+	void UpdateOpenSet(const FAI_NavGraph& Graph, int32 Node);
+
+	// Gets the open set key of a node.
+	float CalculateKey(const FAI_NavGraph& Graph, int32 Node) const;
+
+	// Gets the current cost of a node, or UE_MAX_FLT if it has not been reached.
+	float GetGScore(int32 Node) const { return Generations[Node] == Generation ? GScores[Node] : UE_MAX_FLT; }
+
+	// Gets the cost of a node worked out from its incoming edges, or UE_MAX_FLT if it has not been reached.
+	float GetRhsScore(int32 Node) const { return Generations[Node] == Generation ? RhsScores[Node] : UE_MAX_FLT; }
+
+	// Makes sure a node belongs to the current tree, so its costs can be written.
+	void Touch(int32 Node);
+
+	// Checks if a node is on the path from the root to the goal.
+	bool IsOnPath(int32 Node) const;
+
+	// The current cost of each node.
+	TArray<float> GScores;
+
+	// The cost of each node worked out from the current costs of the nodes before it.
+	TArray<float> RhsScores;
+
+	// The node before each node on its shortest known path from the root.
+	TArray<int32> Parents;
+
+	// The tree generation each node was last written by.
+	TArray<uint32> Generations;
+
+	// The nodes whose two costs disagree.
+	FAI_NodeHeap OpenSet;
+
+	// The generation of the current tree.
+	uint32 Generation = 0;
+
+	// The node the tree grows from.
+	int32 RootNode = INDEX_NONE;
+
+	// The node the agent was at on the last call to Replan.
+	int32 StartNode = INDEX_NONE;
+
+	// The node the path leads to.
+	int32 GoalNode = INDEX_NONE;
+
+	// The version of the graph the tree was grown on.
+	uint32 GraphVersion = 0;
+
+	// How many nodes the last call to Replan expanded.
+	int32 LastExpansions = 0;
+};
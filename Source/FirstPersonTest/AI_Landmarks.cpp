@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_Landmarks.h"
+#include "AI_NavGraph.h"
+#include "AI_NavGraphFile.h"
+#include "AI_PathSearch.h"
+#include "Async/ParallelFor.h"
+
+// Each new landmark is the node furthest from every landmark picked so far, so the landmarks end up spread around the edges of the map.
+// Nodes that no landmark can reach count as infinitely far away, which also puts a landmark in every separate part of the graph.
+void FAI_Landmarks::Build(const FAI_NavGraph& Graph, int32 MaxLandmarks)
+{
+	Empty();
+
+	const int32 NodeCount = Graph.NumNodes();
+	const int32 LandmarkCount = FMath::Min(MaxLandmarks, NodeCount);
+	if (LandmarkCount <= 0)
+	{
+		return;
+	}
+
+	FAI_SearchContext Context;
+
+	// Start from the node furthest from the first node.
+	TArray<float> ClosestLandmarkDistances;
+	ClosestLandmarkDistances.Init(0.0f, NodeCount);
+	Context.FindAllDistances(Graph, 0, false);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		ClosestLandmarkDistances[Node] = Context.IsVisited(Node) ? Context.GScores[Node] : 0.0f;
+	}
+
+	DistancesFrom.SetNumUninitialized(NodeCount * LandmarkCount);
+	DistancesTo.SetNumUninitialized(NodeCount * LandmarkCount);
+
+	for (int32 Landmark = 0; Landmark < LandmarkCount; Landmark++)
+	{
+		int32 FurthestNode = INDEX_NONE;
+		float FurthestDistance = -1.0f;
+		for (int32 Node = 0; Node < NodeCount; Node++)
+		{
+			// Removed nodes have no edges, so they would each look like a separate part of the graph.
+			if (Graph.IsNodeRemoved(Node))
+			{
+				continue;
+			}
+			if (ClosestLandmarkDistances[Node] > FurthestDistance)
+			{
+				FurthestDistance = ClosestLandmarkDistances[Node];
+				FurthestNode = Node;
+			}
+		}
+
+		// Every node is a landmark already, or every node has been removed.
+		if (FurthestNode == INDEX_NONE || (FurthestDistance <= 0.0f && Landmark > 0))
+		{
+			break;
+		}
+		LandmarkNodes.Add(FurthestNode);
+
+		// The forward distances are needed to pick the next landmark anyway, so they are stored straight away.
+		Context.FindAllDistances(Graph, FurthestNode, false);
+		for (int32 Node = 0; Node < NodeCount; Node++)
+		{
+			const float Distance = Context.IsVisited(Node) ? Context.GScores[Node] : UE_MAX_FLT;
+			DistancesFrom[Node * LandmarkCount + Landmark] = Distance;
+			ClosestLandmarkDistances[Node] = Landmark == 0 ? Distance : FMath::Min(ClosestLandmarkDistances[Node], Distance);
+		}
+	}
+
+	// If the graph ran out of nodes to pick, then squash the distances down to the landmarks that were picked.
+	const int32 PickedCount = LandmarkNodes.Num();
+	if (PickedCount < LandmarkCount)
+	{
+		for (int32 Node = 0; Node < NodeCount; Node++)
+		{
+			for (int32 Landmark = 0; Landmark < PickedCount; Landmark++)
+			{
+				DistancesFrom[Node * PickedCount + Landmark] = DistancesFrom[Node * LandmarkCount + Landmark];
+			}
+		}
+		DistancesFrom.SetNum(NodeCount * PickedCount);
+		DistancesTo.SetNum(NodeCount * PickedCount);
+	}
+
+	// The backwards searches do not depend on each other, so each landmark is searched on its own worker thread.
+	ParallelFor(PickedCount, [this, &Graph, NodeCount, PickedCount](int32 Landmark)
+	{
+		FAI_SearchContext LandmarkContext;
+		LandmarkContext.FindAllDistances(Graph, LandmarkNodes[Landmark], true);
+		for (int32 Node = 0; Node < NodeCount; Node++)
+		{
+			DistancesTo[Node * PickedCount + Landmark] = LandmarkContext.IsVisited(Node) ? LandmarkContext.GScores[Node] : UE_MAX_FLT;
+		}
+	});
+}
+
+void FAI_Landmarks::Empty()
+{
+	LandmarkNodes.Reset();
+	DistancesFrom.Reset();
+	DistancesTo.Reset();
+}
+
+void FAI_Landmarks::SaveTo(FAI_NavGraphFileWriter& File) const
+{
+	File.AddSection(EAI_NavGraphSection::LandmarkNodes, LandmarkNodes);
+	File.AddSection(EAI_NavGraphSection::LandmarkDistancesFrom, DistancesFrom);
+	File.AddSection(EAI_NavGraphSection::LandmarkDistancesTo, DistancesTo);
+}
+
+// A file cooked with a different number of landmarks is turned down, so changing NumLandmarks takes effect without cooking again.
+bool FAI_Landmarks::LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes, int32 MaxLandmarks)
+{
+	Empty();
+
+	const bool bValid = File.ReadSection(EAI_NavGraphSection::LandmarkNodes, LandmarkNodes)
+		&& File.ReadSection(EAI_NavGraphSection::LandmarkDistancesFrom, DistancesFrom)
+		&& File.ReadSection(EAI_NavGraphSection::LandmarkDistancesTo, DistancesTo)
+		&& !LandmarkNodes.IsEmpty() && LandmarkNodes.Num() == FMath::Min(MaxLandmarks, NumExpectedNodes)
+		&& DistancesFrom.Num() == NumExpectedNodes * LandmarkNodes.Num() && DistancesTo.Num() == DistancesFrom.Num();
+	if (!bValid)
+	{
+		Empty();
+	}
+	return bValid;
+}
+
+// For a landmark L, the path from L to the goal is never longer than going through the node, and the same holds for paths to L.
+// Landmarks that cannot reach or be reached from either node give no bound, so they are skipped.
+float FAI_Landmarks::GetLowerBound(int32 Node, int32 GoalNode) const
+{
+	const int32 LandmarkCount = LandmarkNodes.Num();
+	const float* NodeFrom = DistancesFrom.GetData() + Node * LandmarkCount;
+	const float* GoalFrom = DistancesFrom.GetData() + GoalNode * LandmarkCount;
+	const float* NodeTo = DistancesTo.GetData() + Node * LandmarkCount;
+	const float* GoalTo = DistancesTo.GetData() + GoalNode * LandmarkCount;
+
+	float LowerBound = 0.0f;
+	for (int32 Landmark = 0; Landmark < LandmarkCount; Landmark++)
+	{
+		if (NodeFrom[Landmark] != UE_MAX_FLT && GoalFrom[Landmark] != UE_MAX_FLT)
+		{
+			LowerBound = FMath::Max(LowerBound, GoalFrom[Landmark] - NodeFrom[Landmark]);
+		}
+		if (NodeTo[Landmark] != UE_MAX_FLT && GoalTo[Landmark] != UE_MAX_FLT)
+		{
+			LowerBound = FMath::Max(LowerBound, NodeTo[Landmark] - GoalTo[Landmark]);
+		}
+	}
+	return LowerBound;
+}
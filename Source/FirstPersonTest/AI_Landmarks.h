@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+class FAI_NavGraphFileReader;
+class FAI_NavGraphFileWriter;
+
+// The exact distances between a few landmark nodes and every other node, used as an A* heuristic (ALT).
+// By the triangle inequality, the difference between two nodes' distances to a landmark is never more than the distance between them.
+// On maps with long detours this is a much closer estimate than the straight line distance, so far fewer nodes are expanded.
+struct FIRSTPERSONTEST_API FAI_Landmarks
+{
+	// Picks landmarks that are as far apart as possible and works out the distances to and from each of them.
+	void Build(const FAI_NavGraph& Graph, int32 MaxLandmarks);
+
+	// Removes every landmark.
+	void Empty();
+
+	// Adds the landmarks and their distances to a cooked graph file.
+	void SaveTo(FAI_NavGraphFileWriter& File) const;
+
+	// Reads the landmarks and their distances from a cooked graph file instead of picking them.
+	// Returns false, leaving no landmarks, if the file has no landmarks for NumExpectedNodes nodes, or not as many as Build would pick with MaxLandmarks.
+	bool LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes, int32 MaxLandmarks);
+
+	// Checks if there are no landmarks.
+	bool IsEmpty() const { return LandmarkNodes.Num() == 0; }
+
+	// Gets the number of landmarks.
+	int32 Num() const { return LandmarkNodes.Num(); }
+
+	// Gets a lower bound on the length of the shortest path between two nodes.
+	float GetLowerBound(int32 Node, int32 GoalNode) const;
+
+	// The node of each landmark.
+	TArray<int32> LandmarkNodes;
+
+	// The distance from each landmark to every node, grouped by node so that one node's distances sit next to each other.
+	// UE_MAX_FLT means the node cannot be reached from the landmark.
+	TArray<float> DistancesFrom;
+
+	// The distance from every node to each landmark, grouped by node. UE_MAX_FLT means the landmark cannot be reached from the node.
+	TArray<float> DistancesTo;
+};
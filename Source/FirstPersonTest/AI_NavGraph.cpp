@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_NavGraph.h"
+#include "AI_NavGraphFile.h"
+
+// Copies the node positions into the position arrays and lays out the edges of every node one after another.
+void FAI_NavGraph::Build(const TArray<FVector>& Locations, const TArray<TArray<int32>>& Adjacency)
+{
+	Empty();
+
+	const int32 NodeCount = Locations.Num();
+
+	PositionsX.SetNumUninitialized(NodeCount);
+	PositionsY.SetNumUninitialized(NodeCount);
+	PositionsZ.SetNumUninitialized(NodeCount);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		const FVector3f Location(Locations[Node]);
+		PositionsX[Node] = Location.X;
+		PositionsY[Node] = Location.Y;
+		PositionsZ[Node] = Location.Z;
+	}
+
+	// Count the edges first so that the edge arrays only allocate once.
+	int32 EdgeCount = 0;
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		EdgeCount += Adjacency[Node].Num();
+	}
+
+	EdgeOffsets.SetNumUninitialized(NodeCount + 1);
+	Neighbours.Reserve(EdgeCount);
+	EdgeLengths.Reserve(EdgeCount);
+
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		EdgeOffsets[Node] = Neighbours.Num();
+		for (const int32 AdjacentNode : Adjacency[Node])
+		{
+			Neighbours.Add(AdjacentNode);
+			EdgeLengths.Add(GetDistance(Node, AdjacentNode));
+		}
+	}
+	EdgeOffsets[NodeCount] = Neighbours.Num();
+
+	// Count the edges arriving at each node, then turn the counts into offsets.
+	ReverseEdgeOffsets.SetNumZeroed(NodeCount + 1);
+	for (const int32 Neighbour : Neighbours)
+	{
+		ReverseEdgeOffsets[Neighbour + 1]++;
+	}
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		ReverseEdgeOffsets[Node + 1] += ReverseEdgeOffsets[Node];
+	}
+
+	// Place every edge into the arriving edges of the node it leads to.
+	TArray<int32> NextReverseEdge(ReverseEdgeOffsets.GetData(), NodeCount);
+	ReverseNeighbours.SetNumUninitialized(EdgeCount);
+	ReverseEdgeLengths.SetNumUninitialized(EdgeCount);
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		for (int32 Edge = GetFirstEdge(Node); Edge < GetLastEdge(Node); Edge++)
+		{
+			const int32 ReverseEdge = NextReverseEdge[Neighbours[Edge]]++;
+			ReverseNeighbours[ReverseEdge] = Node;
+			ReverseEdgeLengths[ReverseEdge] = EdgeLengths[Edge];
+		}
+	}
+}
+
+void FAI_NavGraph::Empty()
+{
+	EdgeOffsets.Reset();
+	Neighbours.Reset();
+	EdgeLengths.Reset();
+	ReverseEdgeOffsets.Reset();
+	ReverseNeighbours.Reset();
+	ReverseEdgeLengths.Reset();
+	PositionsX.Reset();
+	PositionsY.Reset();
+	PositionsZ.Reset();
+	RemovedNodes.Empty();
+	Landmarks.Empty();
+	Components.Empty();
+	SpatialIndex.Empty();
+	NextHopTable.Empty();
+}
+
+void FAI_NavGraph::SaveTo(FAI_NavGraphFileWriter& File) const
+{
+	File.AddSection(EAI_NavGraphSection::PositionsX, PositionsX);
+	File.AddSection(EAI_NavGraphSection::PositionsY, PositionsY);
+	File.AddSection(EAI_NavGraphSection::PositionsZ, PositionsZ);
+	File.AddSection(EAI_NavGraphSection::EdgeOffsets, EdgeOffsets);
+	File.AddSection(EAI_NavGraphSection::Neighbours, Neighbours);
+	File.AddSection(EAI_NavGraphSection::EdgeLengths, EdgeLengths);
+	File.AddSection(EAI_NavGraphSection::ReverseEdgeOffsets, ReverseEdgeOffsets);
+	File.AddSection(EAI_NavGraphSection::ReverseNeighbours, ReverseNeighbours);
+	File.AddSection(EAI_NavGraphSection::ReverseEdgeLengths, ReverseEdgeLengths);
+}
+
+// Checks that the offsets of a compressed sparse row start at zero, never go down and end at the number of edges,
+// and that every edge leads to a node of the graph.
+static bool AreEdgesValid(const TArray<int32>& Offsets, const TArray<int32>& Nodes, int32 NodeCount)
+{
+	if (Offsets.Num() != NodeCount + 1 || Offsets[0] != 0 || Offsets.Last() != Nodes.Num())
+	{
+		return false;
+	}
+
+	for (int32 Node = 0; Node < NodeCount; Node++)
+	{
+		if (Offsets[Node] > Offsets[Node + 1])
+		{
+			return false;
+		}
+	}
+
+	for (const int32 Node : Nodes)
+	{
+		if (Node < 0 || Node >= NodeCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// A file that was damaged or written by a broken cook could still match the hash of the nodes, so every offset and index is checked
+// before the graph is searched.
+bool FAI_NavGraph::LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes)
+{
+	Empty();
+
+	const bool bRead = File.ReadSection(EAI_NavGraphSection::PositionsX, PositionsX)
+		&& File.ReadSection(EAI_NavGraphSection::PositionsY, PositionsY)
+		&& File.ReadSection(EAI_NavGraphSection::PositionsZ, PositionsZ)
+		&& File.ReadSection(EAI_NavGraphSection::EdgeOffsets, EdgeOffsets)
+		&& File.ReadSection(EAI_NavGraphSection::Neighbours, Neighbours)
+		&& File.ReadSection(EAI_NavGraphSection::EdgeLengths, EdgeLengths)
+		&& File.ReadSection(EAI_NavGraphSection::ReverseEdgeOffsets, ReverseEdgeOffsets)
+		&& File.ReadSection(EAI_NavGraphSection::ReverseNeighbours, ReverseNeighbours)
+		&& File.ReadSection(EAI_NavGraphSection::ReverseEdgeLengths, ReverseEdgeLengths);
+
+	const int32 NodeCount = PositionsX.Num();
+	const bool bValid = bRead && NodeCount == NumExpectedNodes && PositionsY.Num() == NodeCount && PositionsZ.Num() == NodeCount
+		&& EdgeLengths.Num() == Neighbours.Num() && ReverseNeighbours.Num() == Neighbours.Num() && ReverseEdgeLengths.Num() == Neighbours.Num()
+		&& AreEdgesValid(EdgeOffsets, Neighbours, NodeCount) && AreEdgesValid(ReverseEdgeOffsets, ReverseNeighbours, NodeCount);
+	if (!bValid)
+	{
+		Empty();
+	}
+	return bValid;
+}
+
+float FAI_NavGraph::GetDistanceSquared(int32 Node, const FVector3f& Location) const
+{
+	const float DeltaX = PositionsX[Node] - Location.X;
+	const float DeltaY = PositionsY[Node] - Location.Y;
+	const float DeltaZ = PositionsZ[Node] - Location.Z;
+	return DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+}
+
+float FAI_NavGraph::GetDistance(int32 NodeA, int32 NodeB) const
+{
+	const float DeltaX = PositionsX[NodeA] - PositionsX[NodeB];
+	const float DeltaY = PositionsY[NodeA] - PositionsY[NodeB];
+	const float DeltaZ = PositionsZ[NodeA] - PositionsZ[NodeB];
+	return FMath::Sqrt(DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ);
+}
+
+int32 FAI_NavGraph::FindEdge(int32 FromNode, int32 ToNode) const
+{
+	for (int32 Edge = GetFirstEdge(FromNode); Edge < GetLastEdge(FromNode); Edge++)
+	{
+		if (Neighbours[Edge] == ToNode)
+		{
+			return Edge;
+		}
+	}
+	return INDEX_NONE;
+}
+
+// Both estimates never overestimate the path length, so the larger of the two is the closer one and still never overestimates.
+float FAI_NavGraph::GetHeuristic(int32 Node, int32 GoalNode) const
+{
+	const float Distance = GetDistance(Node, GoalNode);
+	return Landmarks.IsEmpty() ? Distance : FMath::Max(Distance, Landmarks.GetLowerBound(Node, GoalNode));
+}
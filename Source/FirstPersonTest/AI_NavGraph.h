@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI_GraphComponents.h"
+#include "AI_Landmarks.h"
+#include "AI_NextHopTable.h"
+#include "AI_SpatialIndex.h"
+
+class FAI_NavGraphFileReader;
+class FAI_NavGraphFileWriter;
+
+// A baked, contiguous copy of the navigation graph that path queries run against.
+// Adjacency is stored in compressed sparse row form and node positions as separate float arrays,
+// so a search walks a few flat arrays instead of chasing navigation actors around the heap.
+// Once published, a graph is only ever read, together with the lookups built from it, so any thread holding a reference can query it without a lock.
+struct FIRSTPERSONTEST_API FAI_NavGraph
+{
+	// Compiles the graph from the node locations and the adjacent node indices of each node.
+	void Build(const TArray<FVector>& Locations, const TArray<TArray<int32>>& Adjacency);
+
+	// Removes every node and edge from the graph.
+	void Empty();
+
+	// Adds the positions and edges of the graph to a cooked graph file. The landmarks are saved on their own.
+	void SaveTo(FAI_NavGraphFileWriter& File) const;
+
+	// Reads the positions and edges of the graph from a cooked graph file instead of building them.
+	// Returns false, leaving the graph empty, if the file does not hold a whole graph of NumExpectedNodes nodes whose edges all lead to nodes of the graph.
+	bool LoadFrom(const FAI_NavGraphFileReader& File, int32 NumExpectedNodes);
+
+	// Gets the number of nodes in the graph.
+	int32 NumNodes() const { return PositionsX.Num(); }
+
+	// Gets the number of edges in the graph.
+	int32 NumEdges() const { return Neighbours.Num(); }
+
+	// Checks if a node has been removed. Removed nodes keep their index, without any edges, until the nodes are numbered again.
+	bool IsNodeRemoved(int32 Node) const { return RemovedNodes.IsValidIndex(Node) && RemovedNodes[Node]; }
+
+	// Gets the location of a node.
+	FVector GetNodeLocation(int32 Node) const { return FVector(PositionsX[Node], PositionsY[Node], PositionsZ[Node]); }
+
+	// Gets the squared distance between a node and a location.
+	float GetDistanceSquared(int32 Node, const FVector3f& Location) const;
+
+	// Gets the straight line distance between two nodes.
+	float GetDistance(int32 NodeA, int32 NodeB) const;
+
+	// Gets the estimate of the path length between two nodes that searches are guided by.
+	// It is the straight line distance, or the landmark bound when that is larger.
+	float GetHeuristic(int32 Node, int32 GoalNode) const;
+
+	// Gets the index of the first edge leaving a node. The edges of a node end where the next node's edges begin.
+	int32 GetFirstEdge(int32 Node) const { return EdgeOffsets[Node]; }
+
+	// Gets the index one past the last edge leaving a node.
+	int32 GetLastEdge(int32 Node) const { return EdgeOffsets[Node + 1]; }
+
+	// Gets the index of the first edge arriving at a node.
+	int32 GetFirstReverseEdge(int32 Node) const { return ReverseEdgeOffsets[Node]; }
+
+	// Gets the index one past the last edge arriving at a node.
+	int32 GetLastReverseEdge(int32 Node) const { return ReverseEdgeOffsets[Node + 1]; }
+
+	// Gets the index of the edge from one node to another, or INDEX_NONE if they are not linked that way.
+	int32 FindEdge(int32 FromNode, int32 ToNode) const;
+
+	// The version of the graph this snapshot was built from. Anything computed from an older version is out of date.
+	uint32 Version = 0;
+
+	// The version the nodes were last numbered at. Node indices from this version onwards still point at the same nodes.
+	uint32 LayoutVersion = 0;
+
+	// Which node indices belong to nodes that have been removed.
+	TBitArray<> RemovedNodes;
+
+	// The index of the first edge of each node, with one extra entry at the end holding the number of edges.
+	TArray<int32> EdgeOffsets;
+
+	// The node each edge leads to.
+	TArray<int32> Neighbours;
+
+	// The length of each edge.
+	TArray<float> EdgeLengths;
+
+	// The same edges grouped by the node they arrive at, so searches can walk the graph backwards.
+	// The index of the first arriving edge of each node, with one extra entry at the end holding the number of edges.
+	TArray<int32> ReverseEdgeOffsets;
+
+	// The node each arriving edge comes from.
+	TArray<int32> ReverseNeighbours;
+
+	// The length of each arriving edge.
+	TArray<float> ReverseEdgeLengths;
+
+	// The distances to and from the landmarks, if any were picked for this graph.
+	FAI_Landmarks Landmarks;
+
+	// Which nodes can reach which.
+	FAI_GraphComponents Components;
+
+	// The spatial index used to find the closest and furthest nodes from a location.
+	FAI_NodeKdTree SpatialIndex;
+
+	// The next node between every pair of nodes, if the graph was small enough for one.
+	// It is only read on the game thread for the newest graph, so the next snapshot may take it over and update it in place.
+	FAI_NextHopTable NextHopTable;
+
+	// The X position of each node.
+	TArray<float> PositionsX;
+
+	// The Y position of each node.
+	TArray<float> PositionsY;
+
+	// The Z position of each node.
+	TArray<float> PositionsZ;
+};
+
+// A reference to a graph snapshot. Whoever holds one keeps that version of the graph alive, however many times the graph is updated after it.
+using FAI_NavGraphRef = TSharedRef<const FAI_NavGraph, ESPMode::ThreadSafe>;
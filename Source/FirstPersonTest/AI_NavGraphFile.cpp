@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_NavGraphFile.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+// The sections are laid out one after another behind the section table, each starting on an aligned offset.
+bool FAI_NavGraphFileWriter::Save(const FString& Filename, uint64 SourceHash) const
+{
+	using FFormat = FAI_NavGraphFileFormat;
+
+	FFormat::FHeader Header;
+	Header.Magic = FFormat::Magic;
+	Header.Version = FFormat::Version;
+	Header.SourceHash = SourceHash;
+	Header.NumSections = Sections.Num();
+
+	TArray<FFormat::FSectionEntry> SectionTable;
+	int64 Offset = Align(int64(sizeof(FFormat::FHeader) + Sections.Num() * sizeof(FFormat::FSectionEntry)), FFormat::SectionAlignment);
+	for (const TPair<EAI_NavGraphSection, TArrayView<const uint8>>& Section : Sections)
+	{
+		FFormat::FSectionEntry& Entry = SectionTable.AddDefaulted_GetRef();
+		Entry.Section = uint32(Section.Key);
+		Entry.Offset = Offset;
+		Entry.Size = Section.Value.Num();
+		Offset = Align(Offset + Entry.Size, FFormat::SectionAlignment);
+	}
+
+	TArray<uint8> FileData;
+	FileData.SetNumZeroed(Offset);
+	FMemory::Memcpy(FileData.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(FileData.GetData() + sizeof(Header), SectionTable.GetData(), SectionTable.Num() * sizeof(FFormat::FSectionEntry));
+	for (int32 Index = 0; Index < Sections.Num(); Index++)
+	{
+		FMemory::Memcpy(FileData.GetData() + SectionTable[Index].Offset, Sections[Index].Value.GetData(), SectionTable[Index].Size);
+	}
+
+	return FFileHelper::SaveArrayToFile(FileData, *Filename);
+}
+
+FAI_NavGraphFileReader::FAI_NavGraphFileReader() = default;
+
+FAI_NavGraphFileReader::~FAI_NavGraphFileReader()
+{
+	Close();
+}
+
+// Only the header and the section table are read here. The sections are read when they are asked for.
+bool FAI_NavGraphFileReader::Open(const FString& Filename, uint64 SourceHash)
+{
+	using FFormat = FAI_NavGraphFileFormat;
+
+	Close();
+
+	// Opening a handle works the same way for loose files and files inside a pak file.
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	if (!FileHandle)
+	{
+		return false;
+	}
+
+	const int64 FileSize = FileHandle->Size();
+	FFormat::FHeader Header;
+	if (FileSize < int64(sizeof(FFormat::FHeader)) || !FileHandle->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header)))
+	{
+		Close();
+		return false;
+	}
+
+	const int64 TableEnd = int64(sizeof(FFormat::FHeader)) + int64(Header.NumSections) * sizeof(FFormat::FSectionEntry);
+	if (Header.Magic != FFormat::Magic || Header.Version != FFormat::Version || Header.SourceHash != SourceHash || Header.NumSections < 0 || TableEnd > FileSize)
+	{
+		Close();
+		return false;
+	}
+
+	SectionTable.SetNumUninitialized(Header.NumSections);
+	if (!FileHandle->Read(reinterpret_cast<uint8*>(SectionTable.GetData()), SectionTable.Num() * sizeof(FFormat::FSectionEntry)))
+	{
+		Close();
+		return false;
+	}
+
+	for (const FFormat::FSectionEntry& Entry : SectionTable)
+	{
+		if (Entry.Offset < TableEnd || Entry.Size < 0 || Entry.Offset + Entry.Size > FileSize)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FAI_NavGraphFileReader::Close()
+{
+	SectionTable.Empty();
+	FileHandle.Reset();
+}
+
+bool FAI_NavGraphFileReader::ReadBytes(const FAI_NavGraphFileFormat::FSectionEntry& Entry, void* OutData) const
+{
+	return FileHandle && FileHandle->Seek(Entry.Offset) && FileHandle->Read(static_cast<uint8*>(OutData), Entry.Size);
+}
+
+const FAI_NavGraphFileFormat::FSectionEntry* FAI_NavGraphFileReader::FindSection(EAI_NavGraphSection Section) const
+{
+	for (const FAI_NavGraphFileFormat::FSectionEntry& Entry : SectionTable)
+	{
+		if (Entry.Section == uint32(Section))
+		{
+			return &Entry;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IFileHandle;
+
+// The arrays a cooked navigation graph file can hold. The values are stored in the file, so they must never change.
+// New sections are added at the end, and files without them simply fall back to building that part.
+enum class EAI_NavGraphSection : uint32
+{
+	PositionsX = 0,
+	PositionsY = 1,
+	PositionsZ = 2,
+	EdgeOffsets = 3,
+	Neighbours = 4,
+	EdgeLengths = 5,
+	ReverseEdgeOffsets = 6,
+	ReverseNeighbours = 7,
+	ReverseEdgeLengths = 8,
+	StrongComponents = 9,
+	StrongComponentNodes = 10,
+	StrongComponentOffsets = 11,
+	WeakComponents = 12,
+	WeakComponentNodes = 13,
+	WeakComponentOffsets = 14,
+	ReachableComponents = 15,
+	ReachableNodeCounts = 16,
+	LandmarkNodes = 17,
+	LandmarkDistancesFrom = 18,
+	LandmarkDistancesTo = 19,
+	NextHops = 20
+};
+
+// The layout of a cooked navigation graph file: a header, a table of sections, then the raw bytes of every section.
+// Every section is the memory of one array exactly as it is held at runtime, so loading one is a single read with no parsing.
+struct FAI_NavGraphFileFormat
+{
+	// The first four bytes of every file, "AING". A file written with the other byte order reads as a different number and is turned down.
+	static constexpr uint32 Magic = 0x474E4941;
+
+	// Goes up whenever the meaning of a section changes. Files of another version are ignored and the graph is built instead.
+	static constexpr uint32 Version = 1;
+
+	// Every section starts on a multiple of this many bytes.
+	static constexpr int64 SectionAlignment = 16;
+
+	// The start of every file.
+	struct FHeader
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+
+		// A hash of the node locations and links the graph was built from, so a file is only used for the nodes it was cooked from.
+		uint64 SourceHash = 0;
+
+		// How many entries the section table has.
+		int32 NumSections = 0;
+		int32 Padding = 0;
+	};
+
+	// Where one section is in the file.
+	struct FSectionEntry
+	{
+		uint32 Section = 0;
+		uint32 Padding = 0;
+		int64 Offset = 0;
+		int64 Size = 0;
+	};
+};
+
+// Gathers the arrays of a baked graph and writes them to a cooked navigation graph file.
+// The arrays are only referenced, so they have to stay alive until the file is saved.
+class FIRSTPERSONTEST_API FAI_NavGraphFileWriter
+{
+public:
+
+	// Adds the memory of an array as a section.
+	template<typename ElementType>
+	void AddSection(EAI_NavGraphSection Section, const TArray<ElementType>& Array)
+	{
+		static_assert(TIsPODType<ElementType>::Value, "Only plain data can be written to a cooked navigation graph.");
+		Sections.Emplace(Section, TArrayView<const uint8>(reinterpret_cast<const uint8*>(Array.GetData()), Array.Num() * sizeof(ElementType)));
+	}
+
+	// Writes the file. Returns false if it could not be written.
+	bool Save(const FString& Filename, uint64 SourceHash) const;
+
+private:
+
+	// The sections that have been added, in the order they are written.
+	TArray<TPair<EAI_NavGraphSection, TArrayView<const uint8>>> Sections;
+};
+
+// Opens a cooked navigation graph file and reads its sections straight into arrays.
+// Only the header and the section table are kept in memory, so a loaded graph is never held twice.
+class FIRSTPERSONTEST_API FAI_NavGraphFileReader
+{
+public:
+
+	FAI_NavGraphFileReader();
+	~FAI_NavGraphFileReader();
+
+	// Opens a file and checks its header and section table. Returns false if the file is missing, of another version,
+	// or was cooked from different nodes.
+	bool Open(const FString& Filename, uint64 SourceHash);
+
+	// Lets go of the file.
+	void Close();
+
+	// Checks if the file is open.
+	bool IsOpen() const { return FileHandle.IsValid(); }
+
+	// Checks if the file holds a section.
+	bool HasSection(EAI_NavGraphSection Section) const { return FindSection(Section) != nullptr; }
+
+	// Reads a section into an array. Returns false if the file does not hold the section, its size is not a whole number of elements,
+	// or it could not be read.
+	template<typename ElementType>
+	bool ReadSection(EAI_NavGraphSection Section, TArray<ElementType>& OutArray) const
+	{
+		static_assert(TIsPODType<ElementType>::Value, "Only plain data can be read from a cooked navigation graph.");
+
+		const FAI_NavGraphFileFormat::FSectionEntry* Entry = FindSection(Section);
+		if (!Entry || Entry->Size % sizeof(ElementType) != 0 || Entry->Size / sizeof(ElementType) > MAX_int32)
+		{
+			return false;
+		}
+
+		OutArray.SetNumUninitialized(int32(Entry->Size / sizeof(ElementType)));
+		if (!ReadBytes(*Entry, OutArray.GetData()))
+		{
+			OutArray.Reset();
+			return false;
+		}
+		return true;
+	}
+
+private:
+
+	// Gets the table entry of a section, or null if the file does not hold it.
+	const FAI_NavGraphFileFormat::FSectionEntry* FindSection(EAI_NavGraphSection Section) const;
+
+	// Reads the bytes of a section into memory that is big enough to hold them.
+	bool ReadBytes(const FAI_NavGraphFileFormat::FSectionEntry& Entry, void* OutData) const;
+
+	// The open file. Reading moves its position, which is not part of the reader's state.
+	TUniquePtr<IFileHandle> FileHandle;
+
+	// The section table, read from the start of the file.
+	TArray<FAI_NavGraphFileFormat::FSectionEntry> SectionTable;
+};
@@ -13,6 +13,9 @@ class FIRSTPERSONTEST_API AAI_Navigation : public AActor
 
 	// Works together with AI_Pathfinding class
 	friend class UAI_Pathfinding;
+
+	// Is copied into AI_NavigationGraph actors
+	friend class AAI_NavigationGraph;
 	
 public:	
 	// Sets default values for this actor's properties
@@ -20,9 +23,12 @@ public:
 
 protected:
 	
-	// Called when the game starts or when spawned
+	// Adds the node to the pathfinding subsystem's graph
 	virtual void BeginPlay() override;
 
+	// Removes the node from the pathfinding subsystem's graph
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// The position of this node itself
 	UPROPERTY(VisibleAnywhere)
 	USceneComponent* LocationComponent;
@@ -31,11 +37,8 @@ protected:
 	UPROPERTY(EditAnywhere)
 	TArray<AAI_Navigation*> AdjacentNodes;
 
-public:
-	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
-	virtual bool ShouldTickIfViewportsOnly() const override;
+	// How likely this node is to be picked as a free roam destination, compared to other nodes. Zero means it is never picked.
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0"))
+	float DestinationWeight = 1.0f;
 
 };
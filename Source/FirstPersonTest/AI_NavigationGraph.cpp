@@ -0,0 +1,279 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_NavigationGraph.h"
+#include "AI_Navigation.h"
+#include "AI_NavigationGraphDebugComponent.h"
+#include "AI_Pathfinding.h"
+#include "EngineUtils.h"
+#include "Async/ParallelFor.h"
+
+#if WITH_EDITOR
+#include "ScopedTransaction.h"
+#endif
+
+// Sets default values
+AAI_NavigationGraph::AAI_NavigationGraph()
+{
+	// The graph is only data, so it never needs to tick.
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Creating a Location Component for the graph, which the node locations are relative to.
+	LocationComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Location Component"));
+	SetRootComponent(LocationComponent);
+
+#if WITH_EDITORONLY_DATA
+	DebugComponent = CreateEditorOnlyDefaultSubobject<UAI_NavigationGraphDebugComponent>(TEXT("Debug Component"));
+	if (DebugComponent)
+	{
+		DebugComponent->SetupAttachment(LocationComponent);
+	}
+#endif
+}
+
+void AAI_NavigationGraph::AppendNodes(TArray<FVector>& Locations, TArray<TArray<int32>>& Adjacency) const
+{
+	const int32 FirstNode = Locations.Num();
+	const FTransform& GraphTransform = GetActorTransform();
+
+	Locations.Reserve(FirstNode + Nodes.Num());
+	Adjacency.Reserve(FirstNode + Nodes.Num());
+	for (const FAI_NavigationGraphNode& Node : Nodes)
+	{
+		Locations.Add(GraphTransform.TransformPosition(Node.Location));
+
+		TArray<int32>& NodeAdjacency = Adjacency.AddDefaulted_GetRef();
+		for (const int32 AdjacentNode : Node.AdjacentNodes)
+		{
+			// Check if the connected node exists, as the indices can be edited by hand.
+			if (Nodes.IsValidIndex(AdjacentNode))
+			{
+				NodeAdjacency.Add(FirstNode + AdjacentNode);
+			}
+		}
+	}
+}
+
+void AAI_NavigationGraph::AppendDestinationWeights(TArray<float>& Weights) const
+{
+	Weights.Reserve(Weights.Num() + Nodes.Num());
+	for (const FAI_NavigationGraphNode& Node : Nodes)
+	{
+		Weights.Add(Node.DestinationWeight);
+	}
+}
+
+void AAI_NavigationGraph::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UAI_Pathfinding* PathfindingSubsystem = GetWorld()->GetSubsystem<UAI_Pathfinding>())
+	{
+		PathfindingSubsystem->RegisterGraph(this);
+	}
+}
+
+void AAI_NavigationGraph::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UAI_Pathfinding* PathfindingSubsystem = GetWorld()->GetSubsystem<UAI_Pathfinding>())
+	{
+		PathfindingSubsystem->UnregisterGraph(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+#if WITH_EDITOR
+void AAI_NavigationGraph::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	if (DebugComponent)
+	{
+		DebugComponent->RefreshGraph();
+	}
+}
+
+// The node actors are numbered first, so links between them can be turned into indices in one pass.
+void AAI_NavigationGraph::ImportNavigationNodes()
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	const FScopedTransaction Transaction(NSLOCTEXT("AI_NavigationGraph", "ImportNavigationNodes", "Import Navigation Nodes"));
+	Modify();
+
+	TArray<AAI_Navigation*> NavigationNodes;
+	TMap<AAI_Navigation*, int32> NodeIndices;
+	for (TActorIterator<AAI_Navigation> It(World); It; ++It)
+	{
+		NodeIndices.Add(*It, Nodes.Num() + NavigationNodes.Add(*It));
+	}
+
+	const FTransform& GraphTransform = GetActorTransform();
+	for (const AAI_Navigation* NavigationNode : NavigationNodes)
+	{
+		FAI_NavigationGraphNode& Node = Nodes.AddDefaulted_GetRef();
+		Node.Location = GraphTransform.InverseTransformPosition(NavigationNode->GetActorLocation());
+		Node.DestinationWeight = NavigationNode->DestinationWeight;
+
+		for (AAI_Navigation* AdjacentNode : NavigationNode->AdjacentNodes)
+		{
+			if (const int32* AdjacentIndex = NodeIndices.Find(AdjacentNode))
+			{
+				Node.AdjacentNodes.Add(*AdjacentIndex);
+			}
+		}
+	}
+
+	for (AAI_Navigation* NavigationNode : NavigationNodes)
+	{
+		World->EditorDestroyActor(NavigationNode, true);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Imported %d navigation nodes into %s"), NavigationNodes.Num(), *GetActorNameOrLabel())
+
+	if (DebugComponent)
+	{
+		DebugComponent->RefreshGraph();
+	}
+}
+
+// Candidate pairs are found first, then every sweep is run in parallel. Sweeps only read the physics scene, so they can run on worker threads.
+// A sweep is the same both ways, so each pair is only swept once and linked in both directions.
+void AAI_NavigationGraph::GenerateLinks()
+{
+	UWorld* World = GetWorld();
+	if (!World || Nodes.Num() < 2)
+	{
+		return;
+	}
+
+	TArray<FVector> Locations;
+	Locations.Reserve(Nodes.Num());
+	const FTransform& GraphTransform = GetActorTransform();
+	for (const FAI_NavigationGraphNode& Node : Nodes)
+	{
+		Locations.Add(GraphTransform.TransformPosition(Node.Location));
+	}
+
+	if (LinkRadius <= 0.0f)
+	{
+		return;
+	}
+
+	// The nodes are put in a grid of cells as wide as the link radius, so the nodes close enough to be linked to a node are all in the cells around its own.
+	const auto GetCell = [this](const FVector& Location)
+	{
+		return FIntVector(FMath::FloorToInt(Location.X / LinkRadius), FMath::FloorToInt(Location.Y / LinkRadius), FMath::FloorToInt(Location.Z / LinkRadius));
+	};
+
+	TMap<FIntVector, TArray<int32>> Grid;
+	for (int32 Node = 0; Node < Locations.Num(); Node++)
+	{
+		Grid.FindOrAdd(GetCell(Locations[Node])).Add(Node);
+	}
+
+	// Every pair of nodes close enough to be linked, with the smaller node first.
+	// They are sorted so the links come out the same whatever order the grid is walked in.
+	const float LinkRadiusSquared = FMath::Square(LinkRadius);
+	TArray<TPair<int32, int32>> Candidates;
+	for (int32 NodeA = 0; NodeA < Locations.Num(); NodeA++)
+	{
+		const FIntVector Cell = GetCell(Locations[NodeA]);
+		for (int32 X = -1; X <= 1; X++)
+		{
+			for (int32 Y = -1; Y <= 1; Y++)
+			{
+				for (int32 Z = -1; Z <= 1; Z++)
+				{
+					const TArray<int32>* CellNodes = Grid.Find(Cell + FIntVector(X, Y, Z));
+					if (!CellNodes)
+					{
+						continue;
+					}
+
+					for (const int32 NodeB : *CellNodes)
+					{
+						if (NodeB > NodeA && FVector::DistSquared(Locations[NodeA], Locations[NodeB]) <= LinkRadiusSquared)
+						{
+							Candidates.Emplace(NodeA, NodeB);
+						}
+					}
+				}
+			}
+		}
+	}
+	Candidates.Sort();
+
+	const FVector SweepOffset(0.0f, 0.0f, SweepHeight);
+	const FCollisionShape Capsule = FCollisionShape::MakeCapsule(AgentRadius, AgentHalfHeight);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AI_GenerateLinks), false, this);
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+
+	TArray<bool> bClear;
+	bClear.SetNumZeroed(Candidates.Num());
+	ParallelFor(Candidates.Num(), [&](int32 Index)
+	{
+		const FVector Start = Locations[Candidates[Index].Key] + SweepOffset;
+		const FVector End = Locations[Candidates[Index].Value] + SweepOffset;
+		bClear[Index] = !World->SweepTestByObjectType(Start, End, FQuat::Identity, ObjectParams, Capsule, QueryParams);
+	});
+
+	// Gather the clear links of every node, then keep the closest ones.
+	// A link is only kept if both of its nodes kept it, so every generated link goes both ways.
+	TArray<TArray<int32>> NewLinks;
+	NewLinks.SetNum(Nodes.Num());
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		if (bClear[Index])
+		{
+			NewLinks[Candidates[Index].Key].Add(Candidates[Index].Value);
+			NewLinks[Candidates[Index].Value].Add(Candidates[Index].Key);
+		}
+	}
+
+	for (int32 Node = 0; Node < Nodes.Num(); Node++)
+	{
+		TArray<int32>& Links = NewLinks[Node];
+		Links.Sort([&Locations, Node](int32 A, int32 B)
+		{
+			return FVector::DistSquared(Locations[Node], Locations[A]) < FVector::DistSquared(Locations[Node], Locations[B]);
+		});
+		if (Links.Num() > MaxLinksPerNode)
+		{
+			Links.SetNum(FMath::Max(MaxLinksPerNode, 0));
+		}
+	}
+
+	const FScopedTransaction Transaction(NSLOCTEXT("AI_NavigationGraph", "GenerateLinks", "Generate Navigation Links"));
+	Modify();
+
+	int32 NumLinks = 0;
+	for (int32 Node = 0; Node < Nodes.Num(); Node++)
+	{
+		TArray<int32>& AdjacentNodes = Nodes[Node].AdjacentNodes;
+		if (bReplaceExistingLinks)
+		{
+			AdjacentNodes.Reset();
+		}
+		for (const int32 Link : NewLinks[Node])
+		{
+			if (NewLinks[Link].Contains(Node))
+			{
+				AdjacentNodes.AddUnique(Link);
+			}
+		}
+		NumLinks += AdjacentNodes.Num();
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Swept %d node pairs and made %d links between %d nodes"), Candidates.Num(), NumLinks, Nodes.Num())
+
+	if (DebugComponent)
+	{
+		DebugComponent->RefreshGraph();
+	}
+}
+#endif
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "AI_NavigationGraph.generated.h"
+
+class UAI_NavigationGraphDebugComponent;
+
+// A single navigation node stored inside an AI_NavigationGraph
+USTRUCT()
+struct FIRSTPERSONTEST_API FAI_NavigationGraphNode
+{
+	GENERATED_BODY()
+
+	// The position of the node, relative to the graph actor
+	UPROPERTY(EditAnywhere)
+	FVector Location = FVector::ZeroVector;
+
+	// The indices of the other nodes of the graph that this node is connected to
+	UPROPERTY(EditAnywhere)
+	TArray<int32> AdjacentNodes;
+
+	// How likely the node is to be picked as a free roam destination, compared to other nodes. Zero means it is never picked.
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0"))
+	float DestinationWeight = 1.0f;
+};
+
+// Every navigation node of a level held by one actor, instead of one AI_Navigation actor per node.
+// It only holds data, so it never ticks and costs nothing per frame.
+UCLASS()
+class FIRSTPERSONTEST_API AAI_NavigationGraph : public AActor
+{
+	GENERATED_BODY()
+
+public:
+
+	// Sets default values for this actor's properties
+	AAI_NavigationGraph();
+
+	// Gets the number of nodes in the graph
+	int32 NumNodes() const { return Nodes.Num(); }
+
+	// Adds the world locations and adjacent node indices of every node to the end of the lists.
+	// The indices are moved along by the number of nodes already in the lists, so several graphs can be added one after another.
+	void AppendNodes(TArray<FVector>& Locations, TArray<TArray<int32>>& Adjacency) const;
+
+	// Adds the free roam destination weight of every node to the end of the list, in the same order as AppendNodes.
+	void AppendDestinationWeights(TArray<float>& Weights) const;
+
+#if WITH_EDITOR
+	// Redraws the graph whenever it is edited or moved in the editor.
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+	// Copies every AI_Navigation actor in the level into this graph, then deletes the actors.
+	// Links to nodes that are missing are dropped. This can be undone.
+	UFUNCTION(CallInEditor, Category = "Navigation")
+	void ImportNavigationNodes();
+
+	// Links every pair of nodes within LinkRadius of each other that an agent could walk between in a straight line.
+	// The lines are checked by sweeping a capsule of the agent's size against the level on worker threads. This can be undone.
+	UFUNCTION(CallInEditor, Category = "Link Generation")
+	void GenerateLinks();
+#endif
+
+protected:
+
+	// Adds the nodes to the pathfinding subsystem's graph
+	virtual void BeginPlay() override;
+
+	// Removes the nodes from the pathfinding subsystem's graph
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// The position of the graph
+	UPROPERTY(VisibleAnywhere)
+	USceneComponent* LocationComponent;
+
+	// The nodes of the graph
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	TArray<FAI_NavigationGraphNode> Nodes;
+
+#if WITH_EDITORONLY_DATA
+	// How far apart two nodes may be to be linked, in centimetres
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	float LinkRadius = 1000.0f;
+
+	// The most links each node is given. The closest nodes are linked first.
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	int32 MaxLinksPerNode = 8;
+
+	// The radius of the capsule swept between nodes, in centimetres
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	float AgentRadius = 34.0f;
+
+	// The half height of the capsule swept between nodes, in centimetres
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	float AgentHalfHeight = 88.0f;
+
+	// How far above the nodes the centre of the capsule is swept, in centimetres, so that it clears the floor the nodes stand on
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	float SweepHeight = 100.0f;
+
+	// Whether the links that are already there are removed first. If not, new links are added to them.
+	UPROPERTY(EditAnywhere, Category = "Link Generation")
+	bool bReplaceExistingLinks = true;
+
+	// Draws the graph in editor viewports
+	UPROPERTY(VisibleAnywhere)
+	UAI_NavigationGraphDebugComponent* DebugComponent;
+#endif
+};
@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_NavigationGraphDebugComponent.h"
+#include "AI_NavGraph.h"
+#include "AI_NavigationGraph.h"
+#include "DebugRenderSceneProxy.h"
+
+// Sets default values
+UAI_NavigationGraphDebugComponent::UAI_NavigationGraphDebugComponent()
+{
+	// The component is only for looking at the graph in the editor, so it is never cooked or shown in game.
+	bIsEditorOnly = true;
+	bHiddenInGame = true;
+	SetCastShadow(false);
+	SetGenerateOverlapEvents(false);
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+}
+
+// The graph is baked the same way the pathfinding subsystem bakes it, so the reverse edges show which edges go both ways
+// without checking the adjacent nodes of every neighbour.
+void UAI_NavigationGraphDebugComponent::RefreshGraph()
+{
+	EdgeLines.Reset();
+	SelfLinkedNodes.Reset();
+	GraphBounds.Init();
+
+	const AAI_NavigationGraph* GraphActor = Cast<AAI_NavigationGraph>(GetOwner());
+	if (GraphActor)
+	{
+		TArray<FVector> Locations;
+		TArray<TArray<int32>> Adjacency;
+		GraphActor->AppendNodes(Locations, Adjacency);
+
+		FAI_NavGraph Graph;
+		Graph.Build(Locations, Adjacency);
+
+		for (int32 Node = 0; Node < Graph.NumNodes(); Node++)
+		{
+			GraphBounds += Graph.GetNodeLocation(Node);
+
+			for (int32 Edge = Graph.GetFirstEdge(Node); Edge < Graph.GetLastEdge(Node); Edge++)
+			{
+				const int32 AdjacentNode = Graph.Neighbours[Edge];
+				if (AdjacentNode == Node)
+				{
+					SelfLinkedNodes.Add(Graph.GetNodeLocation(Node));
+					continue;
+				}
+
+				// An edge goes both ways if the node it leads to also has an edge arriving from it.
+				bool bTwoWay = false;
+				for (int32 ReverseEdge = Graph.GetFirstReverseEdge(Node); ReverseEdge < Graph.GetLastReverseEdge(Node); ReverseEdge++)
+				{
+					if (Graph.ReverseNeighbours[ReverseEdge] == AdjacentNode)
+					{
+						bTwoWay = true;
+						break;
+					}
+				}
+
+				// Two way edges are found from both of their nodes, so only the one from the smaller node is kept.
+				if (bTwoWay && AdjacentNode < Node)
+				{
+					continue;
+				}
+
+				FEdgeLine& Line = EdgeLines.AddDefaulted_GetRef();
+				Line.Start = Graph.GetNodeLocation(Node);
+				Line.End = Graph.GetNodeLocation(AdjacentNode);
+				Line.bOneWay = !bTwoWay;
+			}
+		}
+	}
+
+	UpdateBounds();
+	MarkRenderStateDirty();
+}
+
+void UAI_NavigationGraphDebugComponent::OnRegister()
+{
+	Super::OnRegister();
+	RefreshGraph();
+}
+
+FDebugRenderSceneProxy* UAI_NavigationGraphDebugComponent::CreateDebugSceneProxy()
+{
+#if !UE_BUILD_SHIPPING
+	if (!bDrawGraph || (EdgeLines.IsEmpty() && SelfLinkedNodes.IsEmpty()))
+	{
+		return nullptr;
+	}
+
+	FDebugRenderSceneProxy* Proxy = new FDebugRenderSceneProxy(this);
+
+	// The proxy is shown in editor viewports rather than only in game views.
+	Proxy->ViewFlagName = TEXT("Editor");
+	Proxy->ViewFlagIndex = uint32(FEngineShowFlags::FindIndexByName(*Proxy->ViewFlagName));
+
+	for (const FEdgeLine& Line : EdgeLines)
+	{
+		if (Line.bOneWay)
+		{
+			Proxy->ArrowLines.Emplace(Line.Start, Line.End, FColor::Red);
+		}
+		else
+		{
+			Proxy->Lines.Emplace(Line.Start, Line.End, FColor::Green, 5.0f);
+		}
+	}
+	for (const FVector& Location : SelfLinkedNodes)
+	{
+		Proxy->Spheres.Emplace(50.0f, Location, FColor::Red);
+	}
+
+	return Proxy;
+#else
+	return nullptr;
+#endif
+}
+
+// The lines are stored in world space, so the bounds do not depend on the component's transform.
+FBoxSphereBounds UAI_NavigationGraphDebugComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!GraphBounds.IsValid)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.0f);
+	}
+	return FBoxSphereBounds(GraphBounds.ExpandBy(50.0f));
+}
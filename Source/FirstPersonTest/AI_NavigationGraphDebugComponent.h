@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Debug/DebugDrawComponent.h"
+#include "AI_NavigationGraphDebugComponent.generated.h"
+
+class AAI_NavigationGraph;
+
+// Draws every node and edge of the navigation graph it is attached to in editor viewports.
+// The lines are worked out once when the graph changes and drawn as one batch, so nothing is done per frame or per node.
+// Two way edges are green, one way edges are red arrows and nodes linked to themselves are red spheres.
+UCLASS(ClassGroup = Debug)
+class FIRSTPERSONTEST_API UAI_NavigationGraphDebugComponent : public UDebugDrawComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	// Sets default values for this component's properties
+	UAI_NavigationGraphDebugComponent();
+
+	// Works out the lines again from the graph it is attached to, and redraws them.
+	void RefreshGraph();
+
+	// Whether the graph is drawn. When turned off, the component has nothing to render.
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	bool bDrawGraph = true;
+
+protected:
+
+	virtual void OnRegister() override;
+
+	virtual FDebugRenderSceneProxy* CreateDebugSceneProxy() override;
+
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+
+	// A line between two nodes, in world space.
+	struct FEdgeLine
+	{
+		FVector Start;
+		FVector End;
+
+		// Whether the edge can only be travelled from the start to the end.
+		bool bOneWay = false;
+	};
+
+	// Every edge, with two way edges stored only once.
+	TArray<FEdgeLine> EdgeLines;
+
+	// The nodes that are linked to themselves.
+	TArray<FVector> SelfLinkedNodes;
+
+	// A box around every node.
+	FBox GraphBounds = FBox(ForceInit);
+};
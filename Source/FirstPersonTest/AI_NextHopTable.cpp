@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_NextHopTable.h"
+#include "AI_NavGraph.h"
+#include "AI_NavGraphFile.h"
+#include "AI_PathSearch.h"
+#include "Algo/Reverse.h"
+#include "Async/ParallelFor.h"
+
+// How many end nodes each worker thread handles at a time when building the table.
+static constexpr int32 NextHopBuildBatchSize = 32;
+
+// The last index is kept free, as it marks pairs of nodes that have no path.
+// The table is also limited to what a single array can hold.
+bool FAI_NextHopTable::CanBuild(int32 NumNodes, int64 MemoryBudgetBytes)
+{
+	return NumNodes > 0 && NumNodes < NoNextHop && int64(NumNodes) * int64(NumNodes) <= MAX_int32 && GetMemorySize(NumNodes) <= MemoryBudgetBytes;
+}
+
+// A backwards search from an end node finds the next node towards it from every other node at once,
+// so each search fills one column of the table.
+void FAI_NextHopTable::Build(const FAI_NavGraph& Graph)
+{
+	Empty();
+
+	const int32 NodeCount = Graph.NumNodes();
+	if (!CanBuild(NodeCount, GetMemorySize(NodeCount)))
+	{
+		return;
+	}
+
+	// A new array is made rather than filling the old one, which tables of older graphs may still share.
+	NextHops = MakeShared<TArray<uint16>, ESPMode::ThreadSafe>();
+	NextHops->Init(NoNextHop, NodeCount * NodeCount);
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(NodeCount, NextHopBuildBatchSize);
+	ParallelFor(NumBatches, [this, &Graph, NodeCount](int32 Batch)
+	{
+		// Each batch has its own search state, so the batches never touch the same memory apart from their own columns.
+		FAI_SearchContext Context;
+
+		const int32 FirstEndNode = Batch * NextHopBuildBatchSize;
+		const int32 LastEndNode = FMath::Min(FirstEndNode + NextHopBuildBatchSize, NodeCount);
+		for (int32 EndNode = FirstEndNode; EndNode < LastEndNode; EndNode++)
+		{
+			BuildColumn(Graph, EndNode, Context);
+		}
+	});
+
+	NumNodes = NodeCount;
+	BuiltGraphVersion = Graph.Version;
+}
+
+// Removing nodes can only make paths longer. A column whose shortest paths never pass through a removed node is still the shortest,
+// so only the columns with a next node that has been removed, or whose end node has been removed, are searched again.
+void FAI_NextHopTable::Update(const FAI_NavGraph& Graph)
+{
+	if (NumNodes == 0 || NumNodes != Graph.NumNodes())
+	{
+		Build(Graph);
+		return;
+	}
+
+	// The table is read row by row, so the memory is walked in order.
+	const TArray<uint16>& Table = *NextHops;
+	TBitArray<> StaleColumnBits(false, NumNodes);
+	for (int32 Pair = 0; Pair < Table.Num(); Pair++)
+	{
+		if (Table[Pair] != NoNextHop && Graph.IsNodeRemoved(Table[Pair]))
+		{
+			StaleColumnBits[Pair % NumNodes] = true;
+		}
+	}
+
+	TArray<int32> StaleColumns;
+	for (int32 EndNode = 0; EndNode < NumNodes; EndNode++)
+	{
+		if (StaleColumnBits[EndNode] || Graph.IsNodeRemoved(EndNode))
+		{
+			StaleColumns.Add(EndNode);
+		}
+	}
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(StaleColumns.Num(), NextHopBuildBatchSize);
+	ParallelFor(NumBatches, [this, &Graph, &StaleColumns](int32 Batch)
+	{
+		FAI_SearchContext Context;
+
+		const int32 FirstColumn = Batch * NextHopBuildBatchSize;
+		const int32 LastColumn = FMath::Min(FirstColumn + NextHopBuildBatchSize, StaleColumns.Num());
+		for (int32 Column = FirstColumn; Column < LastColumn; Column++)
+		{
+			BuildColumn(Graph, StaleColumns[Column], Context);
+		}
+	});
+
+	BuiltGraphVersion = Graph.Version;
+	UE_LOG(LogTemp, Display, TEXT("Searched %d of %d next node table columns again"), StaleColumns.Num(), NumNodes)
+}
+
+void FAI_NextHopTable::BuildColumn(const FAI_NavGraph& Graph, int32 EndNode, FAI_SearchContext& Context)
+{
+	const int32 NodeCount = Graph.NumNodes();
+	Context.FindAllDistances(Graph, EndNode, true);
+
+	for (int32 FromNode = 0; FromNode < NodeCount; FromNode++)
+	{
+		uint16& NextHop = (*NextHops)[FromNode * NodeCount + EndNode];
+		if (FromNode == EndNode)
+		{
+			NextHop = uint16(EndNode);
+		}
+		else if (Context.IsVisited(FromNode) && Context.CameFrom[FromNode] != INDEX_NONE)
+		{
+			NextHop = uint16(Context.CameFrom[FromNode]);
+		}
+		else
+		{
+			NextHop = NoNextHop;
+		}
+	}
+}
+
+void FAI_NextHopTable::Empty()
+{
+	NextHops.Reset();
+	NumNodes = 0;
+	BuiltGraphVersion = 0;
+}
+
+void FAI_NextHopTable::SaveTo(FAI_NavGraphFileWriter& File) const
+{
+	File.AddSection(EAI_NavGraphSection::NextHops, *NextHops);
+}
+
+bool FAI_NextHopTable::LoadFrom(const FAI_NavGraphFileReader& File, const FAI_NavGraph& Graph)
+{
+	Empty();
+
+	const int32 NodeCount = Graph.NumNodes();
+	NextHops = MakeShared<TArray<uint16>, ESPMode::ThreadSafe>();
+	if (!CanBuild(NodeCount, GetMemorySize(NodeCount)) || !File.ReadSection(EAI_NavGraphSection::NextHops, *NextHops) || NextHops->Num() != NodeCount * NodeCount)
+	{
+		Empty();
+		return false;
+	}
+
+	NumNodes = NodeCount;
+	BuiltGraphVersion = Graph.Version;
+	return true;
+}
+
+int32 FAI_NextHopTable::GetNextHop(int32 FromNode, int32 ToNode) const
+{
+	const uint16 NextHop = (*NextHops)[FromNode * NumNodes + ToNode];
+	return NextHop == NoNextHop ? INDEX_NONE : int32(NextHop);
+}
+
+// Walks the table from the start node to the end node, then flips the path around to match the order of searched paths.
+bool FAI_NextHopTable::GetPath(int32 StartNode, int32 EndNode, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	int32 CurrentNode = StartNode;
+	OutNodes.Add(CurrentNode);
+
+	while (CurrentNode != EndNode)
+	{
+		CurrentNode = GetNextHop(CurrentNode, EndNode);
+
+		// If there is no path between the nodes, then return an empty path.
+		if (CurrentNode == INDEX_NONE)
+		{
+			OutNodes.Reset();
+			return false;
+		}
+		OutNodes.Add(CurrentNode);
+	}
+
+	Algo::Reverse(OutNodes);
+	return true;
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+struct FAI_SearchContext;
+class FAI_NavGraphFileReader;
+class FAI_NavGraphFileWriter;
+
+// A table holding, for every pair of nodes, the next node to walk to on the shortest path between them.
+// Once built, a path is read out one node at a time without any search. It takes two bytes per pair of nodes,
+// so it is only worth building for small and medium graphs.
+// Copying a table shares its entries rather than copying them, so a new graph snapshot can take over the table of the one before it.
+class FIRSTPERSONTEST_API FAI_NextHopTable
+{
+public:
+
+	// The value stored for pairs of nodes that have no path between them.
+	static constexpr uint16 NoNextHop = MAX_uint16;
+
+	// Gets how many bytes the table would take for a graph with NumNodes nodes.
+	static int64 GetMemorySize(int32 NumNodes) { return int64(NumNodes) * int64(NumNodes) * sizeof(uint16); }
+
+	// Checks if a graph with NumNodes nodes can be stored in a table that fits a memory budget.
+	static bool CanBuild(int32 NumNodes, int64 MemoryBudgetBytes);
+
+	// Builds the table by running a backwards search from every node. The searches are spread over worker threads.
+	void Build(const FAI_NavGraph& Graph);
+
+	// Brings the table up to date with a graph that only had nodes removed since the table was built.
+	// Only the columns whose shortest paths went through a removed node are searched again. They are written in place,
+	// so any copy the table shares its entries with is left out of date. Only the table of the newest graph is ever read, so that copy is not used again.
+	void Update(const FAI_NavGraph& Graph);
+
+	// Removes the table.
+	void Empty();
+
+	// Adds the table to a cooked graph file.
+	void SaveTo(FAI_NavGraphFileWriter& File) const;
+
+	// Reads the table for a graph from a cooked graph file instead of building it. Returns false, leaving no table, if the file has no table for the graph.
+	bool LoadFrom(const FAI_NavGraphFileReader& File, const FAI_NavGraph& Graph);
+
+	// Checks if the table was built for a version of the navigation graph.
+	bool IsBuiltFor(uint32 GraphVersion) const { return NumNodes > 0 && BuiltGraphVersion == GraphVersion; }
+
+	// Gets the next node on the shortest path between two nodes, or INDEX_NONE if there is no path.
+	int32 GetNextHop(int32 FromNode, int32 ToNode) const;
+
+	// Gets the nodes of the shortest path between two nodes, from the end node back to the start node.
+	// Returns false if there is no path.
+	bool GetPath(int32 StartNode, int32 EndNode, TArray<int32>& OutNodes) const;
+
+private:
+
+	// Fills in the column of an end node with a backwards search from it.
+	void BuildColumn(const FAI_NavGraph& Graph, int32 EndNode, FAI_SearchContext& Context);
+
+	// The next node for every pair of nodes, one row per starting node. Shared with the tables copied from this one.
+	TSharedPtr<TArray<uint16>, ESPMode::ThreadSafe> NextHops;
+
+	// The number of nodes in the graph the table was built for.
+	int32 NumNodes = 0;
+
+	// The version of the graph the table was built for.
+	uint32 BuiltGraphVersion = 0;
+};
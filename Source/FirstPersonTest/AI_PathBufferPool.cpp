@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_PathBufferPool.h"
+
+void FAI_CompactPath::Clear()
+{
+	Num = 0;
+	Cursor = 0;
+	GoalNode = INDEX_NONE;
+	bTruncated = false;
+}
+
+// The node counts of a path are 16 bit, so buffers can never hold more nodes than that.
+void FAI_PathBufferPool::Initialize(int32 InBufferCapacity)
+{
+	BufferCapacity = FMath::Clamp(InBufferCapacity, 2, int32(MAX_uint16));
+	Nodes.Empty();
+	FreeBuffers.Empty();
+}
+
+// The nodes come from the end back to the start, so they are copied in reverse to put the next node first.
+void FAI_PathBufferPool::Assign(FAI_CompactPath& Path, TArrayView<const int32> PathNodes, uint32 GraphVersion)
+{
+	Path.Clear();
+	Path.GraphVersion = GraphVersion;
+
+	if (PathNodes.IsEmpty())
+	{
+		return;
+	}
+
+	if (Path.Buffer == INDEX_NONE || Path.Buffer >= NumBuffers())
+	{
+		Path.Buffer = AllocateBuffer();
+	}
+
+	const int32 NumNodes = FMath::Min(PathNodes.Num(), BufferCapacity);
+	int32* Buffer = Nodes.GetData() + Path.Buffer * BufferCapacity;
+	for (int32 Index = 0; Index < NumNodes; Index++)
+	{
+		Buffer[Index] = PathNodes[PathNodes.Num() - 1 - Index];
+	}
+
+	Path.Num = uint16(NumNodes);
+	Path.GoalNode = PathNodes[0];
+	Path.bTruncated = PathNodes.Num() > BufferCapacity;
+}
+
+void FAI_PathBufferPool::Release(FAI_CompactPath& Path)
+{
+	if (Path.Buffer != INDEX_NONE && Path.Buffer < NumBuffers())
+	{
+		FreeBuffers.Push(Path.Buffer);
+	}
+	Path.Buffer = INDEX_NONE;
+	Path.Clear();
+}
+
+int32 FAI_PathBufferPool::GetNode(const FAI_CompactPath& Path, int32 Offset) const
+{
+	if (Offset < 0 || Offset >= Path.NumRemaining() || Path.Buffer == INDEX_NONE || Path.Buffer >= NumBuffers())
+	{
+		return INDEX_NONE;
+	}
+	return Nodes[Path.Buffer * BufferCapacity + Path.Cursor + Offset];
+}
+
+// Buffers are never given back to the allocator, so once every agent has one, new paths never allocate.
+int32 FAI_PathBufferPool::AllocateBuffer()
+{
+	if (!FreeBuffers.IsEmpty())
+	{
+		return FreeBuffers.Pop(false);
+	}
+
+	const int32 Buffer = NumBuffers();
+	Nodes.AddUninitialized(BufferCapacity);
+	return Buffer;
+}
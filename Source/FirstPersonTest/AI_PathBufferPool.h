@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A path that an agent is following, kept as node indices in a buffer owned by a FAI_PathBufferPool.
+// The nodes are stored in the order they are walked, and a cursor marks the next one. Locations are only looked up from the graph when they are needed.
+struct FIRSTPERSONTEST_API FAI_CompactPath
+{
+	// Checks if every node of the path has been walked to.
+	bool IsEmpty() const { return Cursor >= Num; }
+
+	// Gets the number of nodes that have not been walked to yet.
+	int32 NumRemaining() const { return Num - Cursor; }
+
+	// Moves on to the next node of the path.
+	void Advance() { Cursor = FMath::Min<uint16>(Cursor + 1, Num); }
+
+	// Forgets the nodes of the path. The buffer is kept, so the next path does not need a new one.
+	void Clear();
+
+	// The buffer of the pool the nodes are stored in, or INDEX_NONE if the path has never been given one.
+	int32 Buffer = INDEX_NONE;
+
+	// The number of nodes in the buffer.
+	uint16 Num = 0;
+
+	// The next node to walk to.
+	uint16 Cursor = 0;
+
+	// The node the whole path leads to. It is only past the end of the buffer if the path was truncated.
+	int32 GoalNode = INDEX_NONE;
+
+	// The version of the graph the nodes belong to.
+	uint32 GraphVersion = 0;
+
+	// Whether the path was longer than a buffer, so only its first part was kept.
+	bool bTruncated = false;
+
+	// The edge the agent following the path is counted on, or INDEX_NONE. Only the pathfinding subsystem changes it.
+	int32 OccupiedEdge = INDEX_NONE;
+
+	// The version of the graph the occupied edge belongs to.
+	uint32 OccupiedGraphVersion = 0;
+};
+
+// Fixed size buffers of node indices shared by every agent's path.
+// Agents keep their buffer for as long as they live, so a new path only copies nodes rather than allocating.
+class FIRSTPERSONTEST_API FAI_PathBufferPool
+{
+public:
+
+	// Sets how many nodes each buffer holds. Every buffer is dropped.
+	void Initialize(int32 InBufferCapacity);
+
+	// Copies the nodes of a path, from the end node back to the start node, into a path's buffer in the order they are walked.
+	// The path is given a buffer if it does not have one yet. If the path is too long, only the part from the start node is kept.
+	void Assign(FAI_CompactPath& Path, TArrayView<const int32> PathNodes, uint32 GraphVersion);
+
+	// Gives a path's buffer back to the pool and clears the path.
+	void Release(FAI_CompactPath& Path);
+
+	// Gets a node that has not been walked to yet, counting from the next one, or INDEX_NONE if the path does not have that many nodes left.
+	int32 GetNode(const FAI_CompactPath& Path, int32 Offset = 0) const;
+
+	// Gets how many nodes each buffer holds.
+	int32 GetBufferCapacity() const { return BufferCapacity; }
+
+	// Gets how many buffers have been made.
+	int32 NumBuffers() const { return BufferCapacity > 0 ? Nodes.Num() / BufferCapacity : 0; }
+
+	// Gets how many buffers are not being used by a path.
+	int32 NumFreeBuffers() const { return FreeBuffers.Num(); }
+
+private:
+
+	// Takes a buffer from the free list, or makes a new one if the list is empty.
+	int32 AllocateBuffer();
+
+	// Every buffer one after another, BufferCapacity nodes each.
+	TArray<int32> Nodes;
+
+	// The buffers that are not being used by a path.
+	TArray<int32> FreeBuffers;
+
+	// How many nodes each buffer holds.
+	int32 BufferCapacity = 128;
+};
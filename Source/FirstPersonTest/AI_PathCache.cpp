@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_PathCache.h"
+#include "Algo/AnyOf.h"
+
+// Shrinking the cache drops every path, as it only happens when the cache is being resized for a map.
+void FAI_PathCache::SetCapacity(int32 NewCapacity)
+{
+	Capacity = FMath::Max(NewCapacity, 0);
+
+	if (Entries.Num() > Capacity)
+	{
+		Empty();
+	}
+}
+
+void FAI_PathCache::Empty()
+{
+	Entries.Reset();
+	EntryLookup.Reset();
+	Newest = INDEX_NONE;
+	Oldest = INDEX_NONE;
+}
+
+// A hit moves the path to the front of the recently used list.
+const TArray<int32>* FAI_PathCache::Find(int32 StartNode, int32 EndNode, uint32 GraphVersion)
+{
+	CheckGraphVersion(GraphVersion);
+
+	const int32* Entry = EntryLookup.Find(MakeKey(StartNode, EndNode));
+	if (!Entry)
+	{
+		Misses++;
+		return nullptr;
+	}
+
+	Hits++;
+	Unlink(*Entry);
+	LinkAsNewest(*Entry);
+	return &Entries[*Entry].Path;
+}
+
+// New paths reuse the entry of the least recently used path once the cache is full.
+void FAI_PathCache::Add(int32 StartNode, int32 EndNode, uint32 GraphVersion, const TArray<int32>& Path)
+{
+	// Paths found by worker threads on an older graph may still be handed back after the graph has changed.
+	if (Capacity == 0 || GraphVersion < CachedGraphVersion)
+	{
+		return;
+	}
+
+	CheckGraphVersion(GraphVersion);
+
+	const uint64 Key = MakeKey(StartNode, EndNode);
+	int32 Entry = INDEX_NONE;
+
+	if (const int32* ExistingEntry = EntryLookup.Find(Key))
+	{
+		Entry = *ExistingEntry;
+		Unlink(Entry);
+	}
+	else if (Entries.Num() < Capacity)
+	{
+		Entry = Entries.AddDefaulted();
+		EntryLookup.Add(Key, Entry);
+	}
+	else
+	{
+		Entry = Oldest;
+		Unlink(Entry);
+		EntryLookup.Remove(Entries[Entry].Key);
+		EntryLookup.Add(Key, Entry);
+	}
+
+	Entries[Entry].Key = Key;
+	Entries[Entry].Path = Path;
+	LinkAsNewest(Entry);
+}
+
+// Removing nodes can only make paths longer, so a path that avoids every removed node is still the shortest.
+// Paths that were not found stay not found. The paths that are kept are added again from the oldest, so the recently used order is kept too.
+void FAI_PathCache::KeepPathsAvoiding(const TBitArray<>& RemovedNodes, uint32 NewGraphVersion)
+{
+	const auto IsRemoved = [&RemovedNodes](int32 Node)
+	{
+		return RemovedNodes.IsValidIndex(Node) && RemovedNodes[Node];
+	};
+
+	TArray<FEntry> OldEntries = MoveTemp(Entries);
+	const int32 OldOldest = Oldest;
+	Empty();
+	CachedGraphVersion = NewGraphVersion;
+
+	for (int32 Entry = OldOldest; Entry != INDEX_NONE; Entry = OldEntries[Entry].Newer)
+	{
+		const FEntry& OldEntry = OldEntries[Entry];
+		const int32 StartNode = int32(OldEntry.Key >> 32);
+		const int32 EndNode = int32(uint32(OldEntry.Key));
+		if (!IsRemoved(StartNode) && !IsRemoved(EndNode) && !Algo::AnyOf(OldEntry.Path, IsRemoved))
+		{
+			Add(StartNode, EndNode, NewGraphVersion, OldEntry.Path);
+		}
+	}
+}
+
+void FAI_PathCache::GetStats(FAI_PathCacheStats& OutStats) const
+{
+	OutStats.Hits = Hits;
+	OutStats.Misses = Misses;
+	OutStats.NumEntries = EntryLookup.Num();
+	OutStats.Capacity = Capacity;
+}
+
+void FAI_PathCache::ResetStats()
+{
+	Hits = 0;
+	Misses = 0;
+}
+
+void FAI_PathCache::CheckGraphVersion(uint32 GraphVersion)
+{
+	if (GraphVersion != CachedGraphVersion)
+	{
+		Empty();
+		CachedGraphVersion = GraphVersion;
+	}
+}
+
+void FAI_PathCache::Unlink(int32 Entry)
+{
+	FEntry& Unlinked = Entries[Entry];
+
+	if (Unlinked.Newer != INDEX_NONE)
+	{
+		Entries[Unlinked.Newer].Older = Unlinked.Older;
+	}
+	else
+	{
+		Newest = Unlinked.Older;
+	}
+
+	if (Unlinked.Older != INDEX_NONE)
+	{
+		Entries[Unlinked.Older].Newer = Unlinked.Newer;
+	}
+	else
+	{
+		Oldest = Unlinked.Newer;
+	}
+
+	Unlinked.Newer = INDEX_NONE;
+	Unlinked.Older = INDEX_NONE;
+}
+
+void FAI_PathCache::LinkAsNewest(int32 Entry)
+{
+	Entries[Entry].Newer = INDEX_NONE;
+	Entries[Entry].Older = Newest;
+
+	if (Newest != INDEX_NONE)
+	{
+		Entries[Newest].Newer = Entry;
+	}
+	Newest = Entry;
+
+	if (Oldest == INDEX_NONE)
+	{
+		Oldest = Entry;
+	}
+}
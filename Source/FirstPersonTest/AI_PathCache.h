@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The hit and miss counters of the path cache, used to size it for a map
+struct FIRSTPERSONTEST_API FAI_PathCacheStats
+{
+	// How many paths were found in the cache.
+	int64 Hits = 0;
+
+	// How many paths had to be searched because they were not in the cache.
+	int64 Misses = 0;
+
+	// How many asynchronous requests were merged into a search that was already running.
+	int64 CoalescedRequests = 0;
+
+	// How many paths are in the cache right now.
+	int32 NumEntries = 0;
+
+	// How many paths the cache can hold.
+	int32 Capacity = 0;
+};
+
+// A least recently used cache of paths between pairs of navigation nodes.
+// Paths belong to a version of the navigation graph, and the whole cache is dropped when the version changes,
+// unless the cache is moved on to the new version with KeepPathsAvoiding.
+class FIRSTPERSONTEST_API FAI_PathCache
+{
+public:
+
+	// Sets how many paths the cache can hold.
+	void SetCapacity(int32 NewCapacity);
+
+	// Removes every path from the cache.
+	void Empty();
+
+	// Looks up the path between two nodes. Counts a hit or a miss and returns null on a miss.
+	const TArray<int32>* Find(int32 StartNode, int32 EndNode, uint32 GraphVersion);
+
+	// Adds the path between two nodes, dropping the least recently used path if the cache is full.
+	void Add(int32 StartNode, int32 EndNode, uint32 GraphVersion, const TArray<int32>& Path);
+
+	// Moves the cache on to a new graph version that only had nodes removed, dropping the paths that start, end or pass through a removed node.
+	void KeepPathsAvoiding(const TBitArray<>& RemovedNodes, uint32 NewGraphVersion);
+
+	// Gets the hit and miss counters.
+	void GetStats(FAI_PathCacheStats& OutStats) const;
+
+	// Sets the hit and miss counters back to zero.
+	void ResetStats();
+
+	// Makes the key a pair of nodes is stored under.
+	static uint64 MakeKey(int32 StartNode, int32 EndNode) { return (uint64(uint32(StartNode)) << 32) | uint64(uint32(EndNode)); }
+
+private:
+
+	// A cached path, linked into the recently used list.
+	struct FEntry
+	{
+		// The key of the node pair this path belongs to.
+		uint64 Key = 0;
+
+		// The nodes of the path, from the end node back to the start node.
+		TArray<int32> Path;
+
+		// The entry that was used just before this one, or INDEX_NONE if this is the most recently used entry.
+		int32 Newer = INDEX_NONE;
+
+		// The entry that was used just after this one, or INDEX_NONE if this is the least recently used entry.
+		int32 Older = INDEX_NONE;
+	};
+
+	// Drops the cache if it holds paths for a different graph version.
+	void CheckGraphVersion(uint32 GraphVersion);
+
+	// Takes an entry out of the recently used list.
+	void Unlink(int32 Entry);
+
+	// Puts an entry at the front of the recently used list.
+	void LinkAsNewest(int32 Entry);
+
+	// The cached paths. Entries are reused rather than removed.
+	TArray<FEntry> Entries;
+
+	// The entry of each cached node pair.
+	TMap<uint64, int32> EntryLookup;
+
+	// The most recently used entry.
+	int32 Newest = INDEX_NONE;
+
+	// The least recently used entry, which is the next to be dropped.
+	int32 Oldest = INDEX_NONE;
+
+	// How many paths the cache can hold.
+	int32 Capacity = 0;
+
+	// The graph version the cached paths belong to.
+	uint32 CachedGraphVersion = 0;
+
+	// How many paths were found in the cache.
+	int64 Hits = 0;
+
+	// How many paths were not in the cache.
+	int64 Misses = 0;
+};
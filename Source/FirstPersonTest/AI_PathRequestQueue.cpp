@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_PathRequestQueue.h"
+#include "AI_PathCache.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "Tasks/Task.h"
+
+// Looks for a running search for the same pair of nodes first. If there is none, a new search is handed to the task graph.
+// The task keeps the queue, the search and the graph snapshot alive until it has finished.
+// A search that goes around traffic is costed for the agent that asked, with the counters as they were when it started, so it is never shared.
+FAI_PathRequestHandle FAI_PathRequestQueue::Submit(const FAI_NavGraphRef& Graph, int32 StartNode, int32 EndNode, EAI_SearchMode Mode,
+	const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe>& EdgeOccupancy, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete)
+{
+	const FSearchKey Key = MakeSearchKey(StartNode, EndNode, Mode);
+
+	// If the same path is already being searched the same way on the same graph, then wait on that search.
+	const TSharedPtr<FSearch, ESPMode::ThreadSafe> RunningSearch = EdgeOccupancy ? nullptr : FindJoinableSearch(Key, Graph->Version);
+	if (RunningSearch)
+	{
+		CoalescedRequests++;
+		return AddRequest(RunningSearch.ToSharedRef(), MoveTemp(OnComplete));
+	}
+
+	TSharedRef<FSearch, ESPMode::ThreadSafe> Search = MakeShared<FSearch, ESPMode::ThreadSafe>();
+	Search->StartNode = StartNode;
+	Search->EndNode = EndNode;
+	Search->GraphVersion = Graph->Version;
+	Search->Mode = Mode;
+	Search->EdgeOccupancy = EdgeOccupancy;
+	Search->IgnoredEdge = IgnoredEdge;
+
+	const FAI_PathRequestHandle Handle = AddRequest(Search, MoveTemp(OnComplete));
+
+	// Check if either nodes are missing, then fail straight away without starting a search.
+	if (StartNode == INDEX_NONE || EndNode == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Either the start or end node are missing."))
+		Search->Status.store(EAI_PathRequestStatus::Failed, std::memory_order_release);
+		return Handle;
+	}
+
+	if (!EdgeOccupancy)
+	{
+		RunningSearches.Add(Key, Search);
+	}
+
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [Queue = AsShared(), Search, Graph]()
+	{
+		Queue->RunSearch(*Graph, *Search);
+	});
+
+	return Handle;
+}
+
+// The search is only queued here. It is started by RunTimeSlicedSearches once the searches before it have finished.
+FAI_PathRequestHandle FAI_PathRequestQueue::SubmitTimeSliced(const FAI_NavGraphRef& Graph, int32 StartNode, int32 EndNode, EAI_PathRequestPriority Priority,
+	const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe>& EdgeOccupancy, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete)
+{
+	// Time sliced searches always run from one end.
+	const FSearchKey Key = MakeSearchKey(StartNode, EndNode, EAI_SearchMode::Unidirectional);
+
+	// If the same path is already being searched, then wait on that search, and make it as urgent as the most urgent request waiting on it.
+	const TSharedPtr<FSearch, ESPMode::ThreadSafe> RunningSearch = EdgeOccupancy ? nullptr : FindJoinableSearch(Key, Graph->Version);
+	if (RunningSearch)
+	{
+		RunningSearch->Priority = FMath::Max(RunningSearch->Priority, Priority);
+		CoalescedRequests++;
+		return AddRequest(RunningSearch.ToSharedRef(), MoveTemp(OnComplete));
+	}
+
+	TSharedRef<FSearch, ESPMode::ThreadSafe> Search = MakeShared<FSearch, ESPMode::ThreadSafe>();
+	Search->StartNode = StartNode;
+	Search->EndNode = EndNode;
+	Search->GraphVersion = Graph->Version;
+	Search->Priority = Priority;
+	Search->Graph = Graph;
+	Search->EdgeOccupancy = EdgeOccupancy;
+	Search->IgnoredEdge = IgnoredEdge;
+
+	const FAI_PathRequestHandle Handle = AddRequest(Search, MoveTemp(OnComplete));
+
+	// Check if either nodes are missing, then fail straight away without starting a search.
+	if (StartNode == INDEX_NONE || EndNode == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Either the start or end node are missing."))
+		Search->Status.store(EAI_PathRequestStatus::Failed, std::memory_order_release);
+		return Handle;
+	}
+
+	if (!EdgeOccupancy)
+	{
+		RunningSearches.Add(Key, Search);
+	}
+
+	TimeSlicedSearches.Add(Search);
+
+	return Handle;
+}
+
+// The clock is only read between slices, so the budget can be overrun by at most one slice.
+void FAI_PathRequestQueue::RunTimeSlicedSearches(double BudgetSeconds, int32 ExpansionsPerSlice)
+{
+	// Drop the searches nobody is waiting on anymore.
+	TimeSlicedSearches.RemoveAll([this](const TSharedRef<FSearch, ESPMode::ThreadSafe>& Search)
+	{
+		if (!Search->bCancelled.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		if (Search->Context)
+		{
+			ReleaseContext(MoveTemp(Search->Context));
+		}
+		return true;
+	});
+
+	if (TimeSlicedSearches.IsEmpty())
+	{
+		return;
+	}
+
+	// A stable sort keeps searches of the same priority in the order they were asked for.
+	TimeSlicedSearches.StableSort([](const TSharedRef<FSearch, ESPMode::ThreadSafe>& A, const TSharedRef<FSearch, ESPMode::ThreadSafe>& B)
+	{
+		return A->Priority > B->Priority;
+	});
+
+	const double EndTime = FPlatformTime::Seconds() + BudgetSeconds;
+	while (!TimeSlicedSearches.IsEmpty() && FPlatformTime::Seconds() < EndTime)
+	{
+		FSearch& Search = *TimeSlicedSearches[0];
+		const FAI_NavGraph& Graph = *Search.Graph;
+
+		if (!Search.Context)
+		{
+			Search.Context = AcquireContext();
+			Search.Context->EdgeOccupancy = Search.EdgeOccupancy.Get();
+			Search.Context->IgnoredEdge = Search.IgnoredEdge;
+			Search.Context->BeginFindPath(Graph, Search.StartNode, Search.EndNode);
+		}
+
+		const EAI_SearchStatus Status = Search.Context->ContinueFindPath(Graph, ExpansionsPerSlice);
+		if (Status == EAI_SearchStatus::InProgress)
+		{
+			continue;
+		}
+
+		if (Status == EAI_SearchStatus::Succeeded)
+		{
+			Search.Context->ReconstructPath(Search.EndNode, Search.Path);
+		}
+
+		NumSearches.fetch_add(1, std::memory_order_relaxed);
+		ExpandedNodes.fetch_add(Search.Context->LastExpansions, std::memory_order_relaxed);
+
+		ReleaseContext(MoveTemp(Search.Context));
+		Search.Graph.Reset();
+		Search.Status.store(Status == EAI_SearchStatus::Succeeded ? EAI_PathRequestStatus::Succeeded : EAI_PathRequestStatus::Failed, std::memory_order_release);
+		TimeSlicedSearches.RemoveAt(0, 1, false);
+	}
+}
+
+// The request still goes through the queue, so its callback is called on the next tick just like any other request.
+FAI_PathRequestHandle FAI_PathRequestQueue::SubmitFinished(const TArray<int32>& Path, uint32 GraphVersion, FAI_OnPathRequestComplete OnComplete)
+{
+	TSharedRef<FSearch, ESPMode::ThreadSafe> Search = MakeShared<FSearch, ESPMode::ThreadSafe>();
+	Search->Path = Path;
+	Search->GraphVersion = GraphVersion;
+	Search->Status.store(Path.IsEmpty() ? EAI_PathRequestStatus::Failed : EAI_PathRequestStatus::Succeeded, std::memory_order_release);
+
+	return AddRequest(Search, MoveTemp(OnComplete));
+}
+
+EAI_PathRequestStatus FAI_PathRequestQueue::Poll(FAI_PathRequestHandle Handle, TArray<int32>& OutPath, uint32& OutGraphVersion)
+{
+	const FRequest* Request = Requests.Find(Handle.Id);
+	if (!Request)
+	{
+		return EAI_PathRequestStatus::Invalid;
+	}
+
+	const EAI_PathRequestStatus Status = Request->Search->Status.load(std::memory_order_acquire);
+	if (Status != EAI_PathRequestStatus::Pending)
+	{
+		// Other requests may be waiting on the same search, so the path is copied rather than moved.
+		OutPath = Request->Search->Path;
+		OutGraphVersion = Request->Search->GraphVersion;
+		RemoveRequest(Handle.Id);
+	}
+
+	return Status;
+}
+
+void FAI_PathRequestQueue::Cancel(FAI_PathRequestHandle Handle)
+{
+	RemoveRequest(Handle.Id);
+}
+
+// Every search that is still needed has a request waiting on it, including the ones that are not in RunningSearches.
+void FAI_PathRequestQueue::CancelAll()
+{
+	for (const TPair<uint32, FRequest>& Pair : Requests)
+	{
+		Pair.Value.Search->bCancelled.store(true, std::memory_order_relaxed);
+	}
+	for (const TSharedRef<FSearch, ESPMode::ThreadSafe>& Search : TimeSlicedSearches)
+	{
+		if (Search->Context)
+		{
+			ReleaseContext(MoveTemp(Search->Context));
+		}
+	}
+	TimeSlicedSearches.Empty();
+	RunningSearches.Empty();
+	Requests.Empty();
+}
+
+// Finished requests are taken out of the list before any callback runs, because a callback may submit a new request.
+void FAI_PathRequestQueue::DispatchCompleted(TFunctionRef<void(int32 StartNode, int32 EndNode, uint32 GraphVersion, const TArray<int32>& Path)> OnSearchFinished)
+{
+	// Searches that finished can no longer be joined, as their result is about to be handed out.
+	for (auto It = RunningSearches.CreateIterator(); It; ++It)
+	{
+		const FSearch& Search = *It.Value();
+		const EAI_PathRequestStatus Status = Search.Status.load(std::memory_order_acquire);
+		if (Status != EAI_PathRequestStatus::Pending)
+		{
+			// Only searches by edge length alone are kept here, so every path handed out can be cached.
+			OnSearchFinished(Search.StartNode, Search.EndNode, Search.GraphVersion, Search.Path);
+			It.RemoveCurrent();
+		}
+	}
+
+	TArray<TPair<FAI_PathRequestHandle, FRequest>, TInlineAllocator<16>> Completed;
+
+	for (auto It = Requests.CreateIterator(); It; ++It)
+	{
+		const FRequest& Request = It.Value();
+		if (Request.OnComplete.IsBound() && Request.Search->Status.load(std::memory_order_acquire) != EAI_PathRequestStatus::Pending)
+		{
+			FAI_PathRequestHandle Handle;
+			Handle.Id = It.Key();
+			Completed.Emplace(Handle, Request);
+			It.RemoveCurrent();
+		}
+	}
+
+	for (const TPair<FAI_PathRequestHandle, FRequest>& Pair : Completed)
+	{
+		Pair.Value.OnComplete.ExecuteIfBound(Pair.Key, Pair.Value.Search->Path, Pair.Value.Search->GraphVersion);
+	}
+}
+
+FAI_PathRequestQueue::FSearchKey FAI_PathRequestQueue::MakeSearchKey(int32 StartNode, int32 EndNode, EAI_SearchMode Mode)
+{
+	return FSearchKey(FAI_PathCache::MakeKey(StartNode, EndNode), Mode);
+}
+
+TSharedPtr<FAI_PathRequestQueue::FSearch, ESPMode::ThreadSafe> FAI_PathRequestQueue::FindJoinableSearch(const FSearchKey& Key, uint32 GraphVersion) const
+{
+	if (const TSharedRef<FSearch, ESPMode::ThreadSafe>* RunningSearch = RunningSearches.Find(Key))
+	{
+		if ((*RunningSearch)->GraphVersion == GraphVersion && !(*RunningSearch)->bCancelled.load(std::memory_order_relaxed))
+		{
+			return *RunningSearch;
+		}
+	}
+	return nullptr;
+}
+
+FAI_PathRequestHandle FAI_PathRequestQueue::AddRequest(const TSharedRef<FSearch, ESPMode::ThreadSafe>& Search, FAI_OnPathRequestComplete OnComplete)
+{
+	FAI_PathRequestHandle Handle;
+	Handle.Id = NextRequestId++;
+
+	// Zero is never used, as it means no request.
+	if (NextRequestId == 0)
+	{
+		NextRequestId = 1;
+	}
+
+	FRequest& Request = Requests.Add(Handle.Id);
+	Request.Search = Search;
+	Request.OnComplete = MoveTemp(OnComplete);
+	Search->NumWaitingRequests++;
+
+	return Handle;
+}
+
+// The worker thread still holds the search, so it is only flagged here and forgotten by the queue.
+void FAI_PathRequestQueue::RemoveRequest(uint32 RequestId)
+{
+	FRequest Request;
+	if (!Requests.RemoveAndCopyValue(RequestId, Request))
+	{
+		return;
+	}
+
+	FSearch& Search = *Request.Search;
+	Search.NumWaitingRequests--;
+
+	if (Search.NumWaitingRequests == 0 && Search.Status.load(std::memory_order_acquire) == EAI_PathRequestStatus::Pending)
+	{
+		Search.bCancelled.store(true, std::memory_order_relaxed);
+
+		// After a graph update a newer search for the same nodes may have replaced this one, and that one must stay joinable.
+		const FSearchKey Key = MakeSearchKey(Search.StartNode, Search.EndNode, Search.Mode);
+		const TSharedRef<FSearch, ESPMode::ThreadSafe>* RunningSearch = RunningSearches.Find(Key);
+		if (RunningSearch && &RunningSearch->Get() == &Search)
+		{
+			RunningSearches.Remove(Key);
+		}
+	}
+}
+
+void FAI_PathRequestQueue::GetSearchStats(FAI_SearchStats& OutStats) const
+{
+	OutStats.NumSearches = NumSearches.load(std::memory_order_relaxed);
+	OutStats.ExpandedNodes = ExpandedNodes.load(std::memory_order_relaxed);
+}
+
+void FAI_PathRequestQueue::ResetSearchStats()
+{
+	NumSearches.store(0, std::memory_order_relaxed);
+	ExpandedNodes.store(0, std::memory_order_relaxed);
+}
+
+// Runs on a worker thread. The path is written before the status so the game thread never sees a half written path.
+void FAI_PathRequestQueue::RunSearch(const FAI_NavGraph& Graph, FSearch& Search)
+{
+	// If the search was cancelled before it started, then do nothing.
+	if (Search.bCancelled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	TUniquePtr<FAI_SearchContext> Context = AcquireContext();
+	Context->EdgeOccupancy = Search.EdgeOccupancy.Get();
+	Context->IgnoredEdge = Search.IgnoredEdge;
+	bool bFoundPath = false;
+
+	// A bidirectional search needs a second context for the backward half.
+	if (Search.Mode == EAI_SearchMode::Bidirectional)
+	{
+		TUniquePtr<FAI_SearchContext> BackwardContext = AcquireContext();
+		bFoundPath = Context->FindPathBidirectional(Graph, Search.StartNode, Search.EndNode, *BackwardContext, &Search.bCancelled);
+		if (bFoundPath)
+		{
+			Context->ReconstructBidirectionalPath(*BackwardContext, Search.Path);
+		}
+		ReleaseContext(MoveTemp(BackwardContext));
+	}
+	else
+	{
+		bFoundPath = Context->FindPath(Graph, Search.StartNode, Search.EndNode, &Search.bCancelled);
+		if (bFoundPath)
+		{
+			Context->ReconstructPath(Search.EndNode, Search.Path);
+		}
+	}
+
+	NumSearches.fetch_add(1, std::memory_order_relaxed);
+	ExpandedNodes.fetch_add(Context->LastExpansions, std::memory_order_relaxed);
+
+	ReleaseContext(MoveTemp(Context));
+
+	// A cancelled search did not prove that there is no path, so it is never marked as failed.
+	if (!bFoundPath && Search.bCancelled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	Search.Status.store(bFoundPath ? EAI_PathRequestStatus::Succeeded : EAI_PathRequestStatus::Failed, std::memory_order_release);
+}
+
+TUniquePtr<FAI_SearchContext> FAI_PathRequestQueue::AcquireContext()
+{
+	{
+		FScopeLock Lock(&ContextLock);
+		if (!FreeContexts.IsEmpty())
+		{
+			return FreeContexts.Pop(false);
+		}
+	}
+	return MakeUnique<FAI_SearchContext>();
+}
+
+// The context forgets the edges it searched with, so the next search does not read counters that may have been freed.
+void FAI_PathRequestQueue::ReleaseContext(TUniquePtr<FAI_SearchContext> Context)
+{
+	Context->EdgeOccupancy = nullptr;
+	Context->IgnoredEdge = INDEX_NONE;
+
+	FScopeLock Lock(&ContextLock);
+	FreeContexts.Add(MoveTemp(Context));
+}
@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI_EdgeOccupancy.h"
+#include "AI_NavGraph.h"
+#include "AI_PathSearch.h"
+#include <atomic>
+
+// The state of an asynchronous path request
+enum class EAI_PathRequestStatus : uint8
+{
+	// The handle does not belong to a request, or the request has been cancelled or already collected.
+	Invalid,
+	Pending,
+	Succeeded,
+	Failed
+};
+
+// How urgently a time sliced path request is needed. Higher priority searches use the frame budget first.
+enum class EAI_PathRequestPriority : uint8
+{
+	// For enemies that are free-roaming and can wait a few frames.
+	Normal,
+
+	// For enemies that are chasing a player.
+	High
+};
+
+// Identifies an asynchronous path request
+struct FIRSTPERSONTEST_API FAI_PathRequestHandle
+{
+	// The id of the request. Zero means no request.
+	uint32 Id = 0;
+
+	// Checks if this handle belongs to a request.
+	bool IsValid() const { return Id != 0; }
+
+	// Clears the handle so it no longer belongs to a request.
+	void Invalidate() { Id = 0; }
+
+	bool operator==(const FAI_PathRequestHandle& Other) const { return Id == Other.Id; }
+	bool operator!=(const FAI_PathRequestHandle& Other) const { return Id != Other.Id; }
+};
+
+// Called on the game thread when an asynchronous path request has finished, with the nodes of the path from the end node back to the start node
+// and the version of the graph they belong to. The path is empty if no path was found.
+DECLARE_DELEGATE_ThreeParams(FAI_OnPathRequestComplete, FAI_PathRequestHandle, const TArray<int32>&, uint32);
+
+// Runs path searches on task graph worker threads.
+// Requests are submitted and collected on the game thread, while the searches only read an immutable graph snapshot.
+// Requests for the same pair of nodes on the same graph version share a single search.
+class FIRSTPERSONTEST_API FAI_PathRequestQueue : public TSharedFromThis<FAI_PathRequestQueue, ESPMode::ThreadSafe>
+{
+public:
+
+	// Starts searching for a path between two nodes of a graph snapshot on a worker thread.
+	// If the same path is already being searched the same way, the request waits on that search instead.
+	// If EdgeOccupancy is set, the search goes around edges that agents are walking along. It is then never shared with another request,
+	// and its path is not handed to DispatchCompleted to be cached.
+	// IgnoredEdge is the edge the agent asking is walking along, which counts one agent fewer.
+	FAI_PathRequestHandle Submit(const FAI_NavGraphRef& Graph, int32 StartNode, int32 EndNode, EAI_SearchMode Mode,
+		const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe>& EdgeOccupancy, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete);
+
+	// Starts a path search that runs on the game thread a slice at a time, within the budget given to RunTimeSlicedSearches.
+	// Like Submit, the request waits on a search for the same path if there is one.
+	FAI_PathRequestHandle SubmitTimeSliced(const FAI_NavGraphRef& Graph, int32 StartNode, int32 EndNode, EAI_PathRequestPriority Priority,
+		const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe>& EdgeOccupancy, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete);
+
+	// Runs the time sliced searches on the game thread until they have all finished or the budget has run out.
+	// Higher priority searches go first, then older ones. Each search expands ExpansionsPerSlice nodes between checks of the clock.
+	void RunTimeSlicedSearches(double BudgetSeconds, int32 ExpansionsPerSlice);
+
+	// Makes a request that has already finished with a known path, for example one that was found in a cache.
+	FAI_PathRequestHandle SubmitFinished(const TArray<int32>& Path, uint32 GraphVersion, FAI_OnPathRequestComplete OnComplete);
+
+	// Gets the state of a request. If it has finished, the path and the graph version it belongs to are copied out and the request is forgotten.
+	EAI_PathRequestStatus Poll(FAI_PathRequestHandle Handle, TArray<int32>& OutPath, uint32& OutGraphVersion);
+
+	// Stops a request. Its search gives up once no other request is waiting on it, and its callback is never called.
+	void Cancel(FAI_PathRequestHandle Handle);
+
+	// Stops every request.
+	void CancelAll();
+
+	// Hands every search that has finished since the last call, and did not go around busy edges, to a visitor so its path can be cached.
+	// Then calls the callbacks of every finished request that has one. Must be called on the game thread.
+	void DispatchCompleted(TFunctionRef<void(int32 StartNode, int32 EndNode, uint32 GraphVersion, const TArray<int32>& Path)> OnSearchFinished);
+
+	// Gets the number of requests that have not been collected yet.
+	int32 Num() const { return Requests.Num(); }
+
+	// Gets how many requests were merged into a search that was already running.
+	int64 GetNumCoalescedRequests() const { return CoalescedRequests; }
+
+	// Gets how many searches have run on worker threads and how many nodes they expanded.
+	void GetSearchStats(FAI_SearchStats& OutStats) const;
+
+	// Sets the merged request counter back to zero.
+	void ResetCoalescedRequests() { CoalescedRequests = 0; }
+
+	// Sets the search counters back to zero.
+	void ResetSearchStats();
+
+private:
+
+	// A single path search. It is shared between the game thread, the requests waiting on it and the worker thread that runs it.
+	struct FSearch
+	{
+		// The node the path starts from.
+		int32 StartNode = INDEX_NONE;
+
+		// The node the path ends at.
+		int32 EndNode = INDEX_NONE;
+
+		// The version of the graph snapshot the search runs on.
+		uint32 GraphVersion = 0;
+
+		// Whether the search runs from one end or from both.
+		EAI_SearchMode Mode = EAI_SearchMode::Unidirectional;
+
+		// How urgently the path of a time sliced search is needed. Only touched on the game thread.
+		EAI_PathRequestPriority Priority = EAI_PathRequestPriority::Normal;
+
+		// The graph snapshot a time sliced search runs on.
+		TSharedPtr<const FAI_NavGraph, ESPMode::ThreadSafe> Graph;
+
+		// The agents on each edge of the graph, if the search goes around busy edges.
+		TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> EdgeOccupancy;
+
+		// The edge the agent that asked is walking along, which counts one agent fewer in EdgeOccupancy.
+		int32 IgnoredEdge = INDEX_NONE;
+
+		// The state of a time sliced search that has been started, kept between frames. Only touched on the game thread.
+		TUniquePtr<FAI_SearchContext> Context;
+
+		// How many requests are still waiting on this search. Only touched on the game thread.
+		int32 NumWaitingRequests = 0;
+
+		// The nodes of the path that was found, from the end node back to the start node. Only read once the status is no longer pending.
+		TArray<int32> Path;
+
+		// The state of the search, written last by the worker thread.
+		std::atomic<EAI_PathRequestStatus> Status { EAI_PathRequestStatus::Pending };
+
+		// Set by the game thread when no request needs the path anymore.
+		std::atomic<bool> bCancelled { false };
+	};
+
+	// A request waiting on a search.
+	struct FRequest
+	{
+		// The search this request waits on.
+		TSharedPtr<FSearch, ESPMode::ThreadSafe> Search;
+
+		// The callback for when the search has finished. Only touched on the game thread.
+		FAI_OnPathRequestComplete OnComplete;
+	};
+
+	// Identifies the searches that requests can share: the same pair of nodes, searched the same way.
+	using FSearchKey = TTuple<uint64, EAI_SearchMode>;
+
+	// Makes the key of a search by edge length alone.
+	static FSearchKey MakeSearchKey(int32 StartNode, int32 EndNode, EAI_SearchMode Mode);
+
+	// Finds a search for the same pair of nodes and mode on the same graph version that a new request can wait on.
+	TSharedPtr<FSearch, ESPMode::ThreadSafe> FindJoinableSearch(const FSearchKey& Key, uint32 GraphVersion) const;
+
+	// Adds a request waiting on a search and returns its handle.
+	FAI_PathRequestHandle AddRequest(const TSharedRef<FSearch, ESPMode::ThreadSafe>& Search, FAI_OnPathRequestComplete OnComplete);
+
+	// Forgets a request. If it was the last request waiting on a running search, the search is told to stop.
+	void RemoveRequest(uint32 RequestId);
+
+	// Runs a search on the current thread.
+	void RunSearch(const FAI_NavGraph& Graph, FSearch& Search);
+
+	// Takes a search context from the pool, or makes a new one if the pool is empty.
+	TUniquePtr<FAI_SearchContext> AcquireContext();
+
+	// Puts a search context back into the pool.
+	void ReleaseContext(TUniquePtr<FAI_SearchContext> Context);
+
+	// The requests that have not been collected yet, by id. Only touched on the game thread.
+	TMap<uint32, FRequest> Requests;
+
+	// The searches by edge length alone that have been started and not yet handed to DispatchCompleted, by node pair and mode.
+	// Searches that go around traffic are left out, as they are never joined or cached. Only touched on the game thread.
+	TMap<FSearchKey, TSharedRef<FSearch, ESPMode::ThreadSafe>> RunningSearches;
+
+	// The time sliced searches that have not finished yet. Only touched on the game thread.
+	TArray<TSharedRef<FSearch, ESPMode::ThreadSafe>> TimeSlicedSearches;
+
+	// The search contexts that are not being used by a worker thread.
+	TArray<TUniquePtr<FAI_SearchContext>> FreeContexts;
+
+	// Guards the pool of search contexts.
+	FCriticalSection ContextLock;
+
+	// The id the next request will be given.
+	uint32 NextRequestId = 1;
+
+	// How many requests were merged into a search that was already running.
+	int64 CoalescedRequests = 0;
+
+	// How many searches have finished on worker threads.
+	std::atomic<int64> NumSearches { 0 };
+
+	// How many nodes the searches on worker threads have expanded.
+	std::atomic<int64> ExpandedNodes { 0 };
+};
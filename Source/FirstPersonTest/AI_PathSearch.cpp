@@ -0,0 +1,443 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_PathSearch.h"
+#include "AI_EdgeOccupancy.h"
+#include "AI_NavGraph.h"
+#include "Algo/Reverse.h"
+
+// How many nodes a search expands between checks of its cancel flag.
+static constexpr int32 SearchCancelCheckInterval = 256;
+
+// Grows the position table so that every node index of the graph can be looked up.
+void FAI_NodeHeap::Reserve(int32 NumNodes)
+{
+	if (HeapPositions.Num() < NumNodes)
+	{
+		HeapPositions.Init(INDEX_NONE, NumNodes);
+		HeapNodes.Reset();
+		HeapKeys.Reset();
+	}
+	HeapNodes.Reserve(NumNodes);
+	HeapKeys.Reserve(NumNodes);
+}
+
+// Only the nodes still in the heap have a position, so only those need to be reset.
+void FAI_NodeHeap::Empty()
+{
+	for (const int32 Node : HeapNodes)
+	{
+		HeapPositions[Node] = INDEX_NONE;
+	}
+	HeapNodes.Reset();
+	HeapKeys.Reset();
+}
+
+// Adds a node to the bottom of the heap, or lowers the key of a node already in it, and moves it up.
+void FAI_NodeHeap::PushOrDecrease(int32 Node, float Key)
+{
+	int32 Position = HeapPositions[Node];
+	if (Position == INDEX_NONE)
+	{
+		Position = HeapNodes.Add(Node);
+		HeapKeys.Add(Key);
+		HeapPositions[Node] = Position;
+	}
+	else
+	{
+		// The key can only go down, a larger key would need to sift down instead.
+		if (Key >= HeapKeys[Position])
+		{
+			return;
+		}
+		HeapKeys[Position] = Key;
+	}
+	SiftUp(Position);
+}
+
+// Takes the top node off the heap and moves the last node into its place.
+int32 FAI_NodeHeap::Pop()
+{
+	const int32 TopNode = HeapNodes[0];
+	const int32 LastPosition = HeapNodes.Num() - 1;
+
+	Swap(0, LastPosition);
+	HeapNodes.Pop(false);
+	HeapKeys.Pop(false);
+	HeapPositions[TopNode] = INDEX_NONE;
+
+	if (!HeapNodes.IsEmpty())
+	{
+		SiftDown(0);
+	}
+
+	return TopNode;
+}
+
+void FAI_NodeHeap::PushOrUpdate(int32 Node, float Key)
+{
+	const int32 Position = HeapPositions[Node];
+	if (Position == INDEX_NONE)
+	{
+		PushOrDecrease(Node, Key);
+		return;
+	}
+
+	// Only one of these will actually move the entry.
+	HeapKeys[Position] = Key;
+	SiftUp(Position);
+	SiftDown(HeapPositions[Node]);
+}
+
+// Moves the last entry into the removed node's place, then sifts it whichever way it needs to go.
+void FAI_NodeHeap::Remove(int32 Node)
+{
+	const int32 Position = HeapPositions[Node];
+	if (Position == INDEX_NONE)
+	{
+		return;
+	}
+
+	const int32 LastPosition = HeapNodes.Num() - 1;
+	Swap(Position, LastPosition);
+	HeapNodes.Pop(false);
+	HeapKeys.Pop(false);
+	HeapPositions[Node] = INDEX_NONE;
+
+	if (Position < HeapNodes.Num())
+	{
+		const int32 MovedNode = HeapNodes[Position];
+		SiftUp(Position);
+		SiftDown(HeapPositions[MovedNode]);
+	}
+}
+
+// Rebuilding the heap from the bottom up is cheaper than updating every key one at a time.
+void FAI_NodeHeap::UpdateAllKeys(TFunctionRef<float(int32 Node)> GetKey)
+{
+	for (int32 Position = 0; Position < HeapNodes.Num(); Position++)
+	{
+		HeapKeys[Position] = GetKey(HeapNodes[Position]);
+	}
+	for (int32 Position = HeapNodes.Num() / 2 - 1; Position >= 0; Position--)
+	{
+		SiftDown(Position);
+	}
+}
+
+void FAI_NodeHeap::SiftUp(int32 Position)
+{
+	while (Position > 0)
+	{
+		const int32 Parent = (Position - 1) / 2;
+		if (HeapKeys[Parent] <= HeapKeys[Position])
+		{
+			break;
+		}
+		Swap(Parent, Position);
+		Position = Parent;
+	}
+}
+
+void FAI_NodeHeap::SiftDown(int32 Position)
+{
+	const int32 Count = HeapNodes.Num();
+	while (true)
+	{
+		const int32 Left = Position * 2 + 1;
+		const int32 Right = Left + 1;
+		int32 Smallest = Position;
+
+		if (Left < Count && HeapKeys[Left] < HeapKeys[Smallest])
+		{
+			Smallest = Left;
+		}
+		if (Right < Count && HeapKeys[Right] < HeapKeys[Smallest])
+		{
+			Smallest = Right;
+		}
+		if (Smallest == Position)
+		{
+			break;
+		}
+		Swap(Smallest, Position);
+		Position = Smallest;
+	}
+}
+
+void FAI_NodeHeap::Swap(int32 A, int32 B)
+{
+	if (A == B)
+	{
+		return;
+	}
+	HeapNodes.Swap(A, B);
+	HeapKeys.Swap(A, B);
+	HeapPositions[HeapNodes[A]] = A;
+	HeapPositions[HeapNodes[B]] = B;
+}
+
+// Grows the arrays if the graph got bigger and moves on to the next generation.
+void FAI_SearchContext::Begin(int32 NumNodes)
+{
+	if (Generations.Num() < NumNodes)
+	{
+		GScores.SetNumUninitialized(NumNodes);
+		HScores.SetNumUninitialized(NumNodes);
+		CameFrom.SetNumUninitialized(NumNodes);
+		Generations.SetNumZeroed(NumNodes);
+	}
+	OpenSet.Reserve(NumNodes);
+	OpenSet.Empty();
+
+	// When the counter wraps around, old entries could look like they belong to this search, so clear them once.
+	++Generation;
+	if (Generation == 0)
+	{
+		FMemory::Memzero(Generations.GetData(), Generations.Num() * sizeof(uint32));
+		Generation = 1;
+	}
+}
+
+void FAI_SearchContext::Visit(int32 Node, float GScore, float HScore)
+{
+	GScores[Node] = GScore;
+	HScores[Node] = HScore;
+	CameFrom[Node] = INDEX_NONE;
+	Generations[Node] = Generation;
+}
+
+float FAI_SearchContext::GetEdgeCost(const FAI_NavGraph& Graph, int32 Edge) const
+{
+	return EdgeOccupancy ? EdgeOccupancy->GetEdgeCost(Graph, Edge, IgnoredEdge) : Graph.EdgeLengths[Edge];
+}
+
+// Searches from the start node towards the end node, always expanding the open node with the lowest FScore.
+bool FAI_SearchContext::FindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, const std::atomic<bool>* bCancelled)
+{
+	BeginFindPath(Graph, StartNode, EndNode);
+
+	// Run the search a slice at a time, checking in between whether whoever asked for this path still needs it.
+	EAI_SearchStatus Status = ContinueFindPath(Graph, SearchCancelCheckInterval);
+	while (Status == EAI_SearchStatus::InProgress)
+	{
+		if (bCancelled && bCancelled->load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		Status = ContinueFindPath(Graph, SearchCancelCheckInterval);
+	}
+
+	return Status == EAI_SearchStatus::Succeeded;
+}
+
+void FAI_SearchContext::BeginFindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode)
+{
+	// Setup the search state and add the start node to the open set.
+	// The scores of nodes from previous searches are ignored because of the search generation.
+	Begin(Graph.NumNodes());
+	Visit(StartNode, 0.0f, Graph.GetHeuristic(StartNode, EndNode));
+	OpenSet.PushOrDecrease(StartNode, HScores[StartNode]);
+
+	SearchEndNode = EndNode;
+	LastExpansions = 0;
+}
+
+// Everything the search needs to carry on is in the context, so it can stop after any expansion and pick up from there later.
+EAI_SearchStatus FAI_SearchContext::ContinueFindPath(const FAI_NavGraph& Graph, int32 MaxExpansions)
+{
+	// loop until the slice runs out
+	for (int32 Expansion = 0; Expansion < MaxExpansions; Expansion++)
+	{
+		// If the OpenSet heap is empty, then the end node cannot be reached.
+		if (OpenSet.IsEmpty())
+		{
+			return EAI_SearchStatus::Failed;
+		}
+
+		// Take the node in the open set with the lowest FScore.
+		const int32 CurrentNode = OpenSet.Pop();
+		LastExpansions++;
+
+		if (CurrentNode == SearchEndNode)
+		{
+			return EAI_SearchStatus::Succeeded;
+		}
+
+		// For each edge leaving the current node:
+		for (int32 Edge = Graph.GetFirstEdge(CurrentNode); Edge < Graph.GetLastEdge(CurrentNode); Edge++)
+		{
+			const int32 AdjacentNode = Graph.Neighbours[Edge];
+			const float TentativeGScore = GScores[CurrentNode] + GetEdgeCost(Graph, Edge);
+
+			// Check if the adjacent node hasn't been reached by this search, then set its scores.
+			if (!IsVisited(AdjacentNode))
+			{
+				Visit(AdjacentNode, UE_MAX_FLT, Graph.GetHeuristic(AdjacentNode, SearchEndNode));
+			}
+
+			// If the TentativeGScore is less than the current g score, then update this nodes scores and came from.
+			if (TentativeGScore < GScores[AdjacentNode])
+			{
+				CameFrom[AdjacentNode] = CurrentNode;
+				GScores[AdjacentNode] = TentativeGScore;
+
+				// Add the adjacent node to the open set, or move it up if it is already in there.
+				OpenSet.PushOrDecrease(AdjacentNode, TentativeGScore + HScores[AdjacentNode]);
+			}
+		}
+	}
+
+	return OpenSet.IsEmpty() ? EAI_SearchStatus::Failed : EAI_SearchStatus::InProgress;
+}
+
+// Both directions are guided by the average of the two heuristics, so that a node's key means the same thing in both searches.
+// With those keys, once the two smallest keys add up to the best path seen so far, no path through an open node can beat it.
+bool FAI_SearchContext::FindPathBidirectional(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, FAI_SearchContext& Backward, const std::atomic<bool>* bCancelled)
+{
+	FAI_SearchContext& Forward = *this;
+
+	// The potential of a node is half the estimated distance left to the end minus half the estimated distance from the start.
+	// The backward search uses the same potential with the sign flipped.
+	auto GetPotential = [&Graph, StartNode, EndNode](int32 Node)
+	{
+		return 0.5f * (Graph.GetHeuristic(Node, EndNode) - Graph.GetHeuristic(StartNode, Node));
+	};
+
+	Forward.Begin(Graph.NumNodes());
+	Backward.Begin(Graph.NumNodes());
+	Forward.Visit(StartNode, 0.0f, GetPotential(StartNode));
+	Backward.Visit(EndNode, 0.0f, -GetPotential(EndNode));
+	Forward.OpenSet.PushOrDecrease(StartNode, Forward.HScores[StartNode]);
+	Backward.OpenSet.PushOrDecrease(EndNode, Backward.HScores[EndNode]);
+
+	LastExpansions = 0;
+	MeetingNode = StartNode == EndNode ? StartNode : INDEX_NONE;
+	float BestPathLength = StartNode == EndNode ? 0.0f : UE_MAX_FLT;
+
+	while (!Forward.OpenSet.IsEmpty() && !Backward.OpenSet.IsEmpty())
+	{
+		// Stop once no open node on either side can lead to a shorter path than the best one found.
+		if (Forward.OpenSet.TopKey() + Backward.OpenSet.TopKey() >= BestPathLength)
+		{
+			break;
+		}
+
+		// Stop if whoever asked for this path does not need it anymore.
+		if (++LastExpansions % SearchCancelCheckInterval == 0 && bCancelled && bCancelled->load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		// Expand whichever side has the smaller frontier, so the two searches stay balanced.
+		const bool bExpandForward = Forward.OpenSet.Num() <= Backward.OpenSet.Num();
+		FAI_SearchContext& Current = bExpandForward ? Forward : Backward;
+		const FAI_SearchContext& Other = bExpandForward ? Backward : Forward;
+		const TArray<int32>& Offsets = bExpandForward ? Graph.EdgeOffsets : Graph.ReverseEdgeOffsets;
+		const TArray<int32>& EdgeNodes = bExpandForward ? Graph.Neighbours : Graph.ReverseNeighbours;
+		const TArray<float>& Lengths = bExpandForward ? Graph.EdgeLengths : Graph.ReverseEdgeLengths;
+
+		const int32 CurrentNode = Current.OpenSet.Pop();
+
+		// Edges are only followed the way they point: forwards from the start, and backwards from the end.
+		for (int32 Edge = Offsets[CurrentNode]; Edge < Offsets[CurrentNode + 1]; Edge++)
+		{
+			const int32 AdjacentNode = EdgeNodes[Edge];
+			const float EdgeCost = !EdgeOccupancy ? Lengths[Edge] : bExpandForward ? EdgeOccupancy->GetEdgeCost(Graph, Edge, IgnoredEdge) : EdgeOccupancy->GetReverseEdgeCost(Graph, Edge, IgnoredEdge);
+			const float TentativeGScore = Current.GScores[CurrentNode] + EdgeCost;
+
+			if (!Current.IsVisited(AdjacentNode))
+			{
+				Current.Visit(AdjacentNode, UE_MAX_FLT, bExpandForward ? GetPotential(AdjacentNode) : -GetPotential(AdjacentNode));
+			}
+
+			if (TentativeGScore < Current.GScores[AdjacentNode])
+			{
+				Current.CameFrom[AdjacentNode] = CurrentNode;
+				Current.GScores[AdjacentNode] = TentativeGScore;
+				Current.OpenSet.PushOrDecrease(AdjacentNode, TentativeGScore + Current.HScores[AdjacentNode]);
+			}
+
+			// If the other search has reached this node too, then there is a path through it.
+			if (Other.IsVisited(AdjacentNode) && Current.GScores[AdjacentNode] + Other.GScores[AdjacentNode] < BestPathLength)
+			{
+				BestPathLength = Current.GScores[AdjacentNode] + Other.GScores[AdjacentNode];
+				MeetingNode = AdjacentNode;
+			}
+		}
+	}
+
+	return MeetingNode != INDEX_NONE;
+}
+
+// The forward half runs from the meeting node back to the start, and the backward half runs from the meeting node on to the end.
+void FAI_SearchContext::ReconstructBidirectionalPath(const FAI_SearchContext& Backward, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	if (MeetingNode == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Add the backward half first, then flip it so that the path starts with the end node.
+	for (int32 NextNode = Backward.CameFrom[MeetingNode]; NextNode != INDEX_NONE; NextNode = Backward.CameFrom[NextNode])
+	{
+		OutNodes.Push(NextNode);
+	}
+	Algo::Reverse(OutNodes);
+
+	for (int32 NextNode = MeetingNode; NextNode != INDEX_NONE; NextNode = CameFrom[NextNode])
+	{
+		OutNodes.Push(NextNode);
+	}
+}
+
+// The same search as FindPath without an end node or heuristic, so it only stops once every reachable node has been expanded.
+void FAI_SearchContext::FindAllDistances(const FAI_NavGraph& Graph, int32 SourceNode, bool bBackwards)
+{
+	Begin(Graph.NumNodes());
+	Visit(SourceNode, 0.0f, 0.0f);
+	OpenSet.PushOrDecrease(SourceNode, 0.0f);
+
+	const TArray<int32>& Offsets = bBackwards ? Graph.ReverseEdgeOffsets : Graph.EdgeOffsets;
+	const TArray<int32>& EdgeNodes = bBackwards ? Graph.ReverseNeighbours : Graph.Neighbours;
+	const TArray<float>& Lengths = bBackwards ? Graph.ReverseEdgeLengths : Graph.EdgeLengths;
+
+	while (!OpenSet.IsEmpty())
+	{
+		const int32 CurrentNode = OpenSet.Pop();
+
+		for (int32 Edge = Offsets[CurrentNode]; Edge < Offsets[CurrentNode + 1]; Edge++)
+		{
+			const int32 AdjacentNode = EdgeNodes[Edge];
+			const float TentativeGScore = GScores[CurrentNode] + Lengths[Edge];
+
+			if (!IsVisited(AdjacentNode))
+			{
+				Visit(AdjacentNode, UE_MAX_FLT, 0.0f);
+			}
+
+			if (TentativeGScore < GScores[AdjacentNode])
+			{
+				CameFrom[AdjacentNode] = CurrentNode;
+				GScores[AdjacentNode] = TentativeGScore;
+				OpenSet.PushOrDecrease(AdjacentNode, TentativeGScore);
+			}
+		}
+	}
+}
+
+// Follows the came from links of the last search back from the end node.
+void FAI_SearchContext::ReconstructPath(int32 EndNode, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+
+	int32 NextNode = EndNode;
+
+	// While the next node is still part of the path, add it to a list.
+	while (NextNode != INDEX_NONE)
+	{
+		OutNodes.Push(NextNode);
+		NextNode = CameFrom[NextNode];
+	}
+}
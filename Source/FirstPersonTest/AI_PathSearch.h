@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+struct FAI_NavGraph;
+class FAI_EdgeOccupancy;
+
+// Which way a path search runs
+enum class EAI_SearchMode : uint8
+{
+	// Use whichever mode the pathfinding subsystem is set up to prefer.
+	Default,
+
+	// A single A* search from the start node towards the end node.
+	Unidirectional,
+
+	// Two A* searches, one from each end, that stop once the best path through the nodes where they meet is proven to be the shortest.
+	Bidirectional
+};
+
+// The state of a search that runs a slice at a time
+enum class EAI_SearchStatus : uint8
+{
+	InProgress,
+	Succeeded,
+	Failed
+};
+
+// How much work the A* searches have done, used to measure how well the heuristic guides them
+struct FIRSTPERSONTEST_API FAI_SearchStats
+{
+	// How many searches were run.
+	int64 NumSearches = 0;
+
+	// How many nodes the searches expanded in total.
+	int64 ExpandedNodes = 0;
+};
+
+// An indexed binary min-heap of navigation node indices ordered by their FScore.
+// Each node remembers where it sits in the heap, so its key can be lowered without searching for it.
+class FIRSTPERSONTEST_API FAI_NodeHeap
+{
+public:
+
+	// Makes sure the heap can hold every node of a graph with NumNodes nodes. Only allocates when the graph grows.
+	void Reserve(int32 NumNodes);
+
+	// Removes every node from the heap while keeping the memory around for the next search.
+	void Empty();
+
+	// Checks if there are no nodes left in the heap.
+	bool IsEmpty() const { return HeapNodes.Num() == 0; }
+
+	// Gets the number of nodes in the heap.
+	int32 Num() const { return HeapNodes.Num(); }
+
+	// Checks if a node is currently in the heap.
+	bool Contains(int32 Node) const { return HeapPositions[Node] != INDEX_NONE; }
+
+	// Gets the smallest key in the heap. The heap must not be empty.
+	float TopKey() const { return HeapKeys[0]; }
+
+	// Adds a node to the heap, or lowers its key if it is already in the heap.
+	void PushOrDecrease(int32 Node, float Key);
+
+	// Removes the node with the smallest key from the heap and returns it.
+	int32 Pop();
+
+	// Adds a node to the heap, or moves it up or down if it is already in the heap with a different key.
+	void PushOrUpdate(int32 Node, float Key);
+
+	// Takes a node out of the heap if it is in there.
+	void Remove(int32 Node);
+
+	// Works out the key of every node in the heap again, then restores the heap order in one pass.
+	void UpdateAllKeys(TFunctionRef<float(int32 Node)> GetKey);
+
+private:
+
+	// Moves the entry at a heap position up until its parent is smaller.
+	void SiftUp(int32 Position);
+
+	// Moves the entry at a heap position down until both children are larger.
+	void SiftDown(int32 Position);
+
+	// Swaps two heap entries and updates their positions.
+	void Swap(int32 A, int32 B);
+
+	// The node indices in heap order.
+	TArray<int32> HeapNodes;
+
+	// The key of each entry in heap order.
+	TArray<float> HeapKeys;
+
+	// The position of each node in the heap, or INDEX_NONE if it is not in the heap.
+	TArray<int32> HeapPositions;
+};
+
+// The per-search state of an A* search, stored in flat arrays indexed by node.
+// A generation counter marks which entries belong to the current search, so nothing has to be cleared between searches.
+struct FIRSTPERSONTEST_API FAI_SearchContext
+{
+	// Gets the context ready for a new search over a graph with NumNodes nodes.
+	void Begin(int32 NumNodes);
+
+	// Checks if a node has been reached by the current search.
+	bool IsVisited(int32 Node) const { return Generations[Node] == Generation; }
+
+	// Marks a node as reached by the current search with its starting scores.
+	void Visit(int32 Node, float GScore, float HScore);
+
+	// Gets the cost of following an edge in FindPath. It is the edge's length unless the search avoids busy edges.
+	float GetEdgeCost(const FAI_NavGraph& Graph, int32 Edge) const;
+
+	// Runs an A* search between two nodes of a graph. Returns true if the end node was reached.
+	// The search gives up early if the cancel flag is set from another thread.
+	bool FindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, const std::atomic<bool>* bCancelled = nullptr);
+
+	// Starts an A* search between two nodes of a graph without expanding any nodes. It is run with ContinueFindPath.
+	void BeginFindPath(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode);
+
+	// Expands at most MaxExpansions more nodes of the search started by BeginFindPath.
+	// The graph must be the same one the search was started on.
+	EAI_SearchStatus ContinueFindPath(const FAI_NavGraph& Graph, int32 MaxExpansions);
+
+	// Runs a bidirectional A* search between two nodes of a graph. This context searches forwards from the start node,
+	// and the backward context searches the edges in reverse from the end node. Returns true if the searches met.
+	bool FindPathBidirectional(const FAI_NavGraph& Graph, int32 StartNode, int32 EndNode, FAI_SearchContext& Backward, const std::atomic<bool>* bCancelled = nullptr);
+
+	// Gets the nodes of the path found by the last bidirectional search, from the end node back to the start node.
+	void ReconstructBidirectionalPath(const FAI_SearchContext& Backward, TArray<int32>& OutNodes) const;
+
+	// Runs a Dijkstra search from a node over the whole graph. Afterwards GScores holds the distance of every visited node.
+	// Searching backwards follows the edges in reverse, so the distances are to the node rather than from it,
+	// and CameFrom holds the next node on the shortest path towards it.
+	void FindAllDistances(const FAI_NavGraph& Graph, int32 SourceNode, bool bBackwards);
+
+	// Gets the nodes of the path found by the last search, from the end node back to the start node.
+	void ReconstructPath(int32 EndNode, TArray<int32>& OutNodes) const;
+
+	// The cost of the cheapest known path from the start to each node.
+	TArray<float> GScores;
+
+	// The estimated cost from each node to the end node.
+	TArray<float> HScores;
+
+	// The node each node was reached from, or INDEX_NONE for the start node.
+	TArray<int32> CameFrom;
+
+	// The search generation each node was last written by.
+	TArray<uint32> Generations;
+
+	// The nodes that still have to be expanded.
+	FAI_NodeHeap OpenSet;
+
+	// The generation of the current search.
+	uint32 Generation = 0;
+
+	// How many nodes the last call to FindPath expanded. A bidirectional search counts the nodes of both directions.
+	int32 LastExpansions = 0;
+
+	// The end node of the search started by BeginFindPath.
+	int32 SearchEndNode = INDEX_NONE;
+
+	// The node where the two halves of the last bidirectional search's path join.
+	int32 MeetingNode = INDEX_NONE;
+
+	// The agents on each edge, which make the edges cost more to A* searches, or null to search by edge length alone.
+	// Bidirectional searches use the forward context's. The searches that fill tables and flow fields always use edge lengths.
+	const FAI_EdgeOccupancy* EdgeOccupancy = nullptr;
+
+	// The edge the agent the search is for is walking along, which counts one agent fewer in EdgeOccupancy.
+	int32 IgnoredEdge = INDEX_NONE;
+};
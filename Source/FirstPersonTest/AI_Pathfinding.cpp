@@ -1,221 +1,1366 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "AI_Pathfinding.h"
-#include "EngineUtils.h"
+#include "CoreGlobals.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/Sort.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "WorldCollision.h"
 #include "AI_Navigation.h"
+#include "AI_NavigationGraph.h"
+#include "AI_NavGraphFile.h"
+#include "Hash/CityHash.h"
+#include "Misc/Paths.h"
 
-// When the world is first loaded, add all navigation nodes to a list.
-void UAI_Pathfinding::OnWorldBeginPlay(UWorld& InWorld)
+// Compares the search modes on the navigation graph of every world that is playing. Usage: AI.BenchmarkPathSearch [NumQueries]
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkPathSearchCommand(
+	TEXT("AI.BenchmarkPathSearch"),
+	TEXT("Times random path searches with the unidirectional and bidirectional search modes. Usage: AI.BenchmarkPathSearch [NumQueries]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UAI_Pathfinding* Pathfinding = World ? World->GetSubsystem<UAI_Pathfinding>() : nullptr)
+		{
+			Pathfinding->BenchmarkSearchModes(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+		}
+	}));
+
+// Cooks the navigation graph of every world that is playing. Usage: AI.SaveNavGraph
+static FAutoConsoleCommandWithWorldAndArgs SaveNavGraphCommand(
+	TEXT("AI.SaveNavGraph"),
+	TEXT("Writes the baked navigation graph and its tables to the map's cooked graph file, so they are loaded instead of built next time."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UAI_Pathfinding* Pathfinding = World ? World->GetSubsystem<UAI_Pathfinding>() : nullptr)
+		{
+			Pathfinding->SaveCookedGraph();
+		}
+	}));
+
+// Sizes the path cache and the path buffers from the config.
+void UAI_Pathfinding::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	PathCache.SetCapacity(PathCacheCapacity);
+	PathBuffers.Initialize(PathBufferCapacity);
+	VisibilityCache.SetCapacity(VisibilityCacheCapacity);
+}
+
+// Any search still running on a worker thread keeps its own copy of the graph, so it only has to be told to stop.
+void UAI_Pathfinding::Deinitialize()
+{
+	PathRequests->CancelAll();
+	ChaseSearches.Empty();
+	Super::Deinitialize();
+}
+
+// Every frame, apply the nodes that registered since the last frame, cache the paths found by worker threads and call the callbacks
+// of the path requests that have finished. Nodes and enemies begin play in any order while a level loads, so the graph is only baked here,
+// once every node that began play on the same frame has registered. Queries until then use the snapshot that was last published.
+void UAI_Pathfinding::Tick(float DeltaTime)
+{
+	UpdateGraph();
+
+	// Time sliced searches run first, so the paths they finish are handed out on the same frame.
+	if (bTimeSliceSearches)
+	{
+		PathRequests->RunTimeSlicedSearches(SearchBudgetMicroseconds * 0.000001, FMath::Max(ExpansionsPerSlice, 1));
+	}
+
+	PathRequests->DispatchCompleted([this](int32 StartNode, int32 EndNode, uint32 Version, const TArray<int32>& Path)
+	{
+		PathCache.Add(StartNode, EndNode, Version, Path);
+	});
+
+	// Forget the flow fields of targets that no longer exist.
+	for (auto It = FlowFields.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TStatId UAI_Pathfinding::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAI_Pathfinding, STATGROUP_Tickables);
+}
+
+// The node is given the next index, and its links are added to whichever of its adjacent nodes have already registered.
+void UAI_Pathfinding::RegisterNode(AAI_Navigation* Node)
+{
+	if (!Node || NodeIndices.Contains(TObjectKey<AAI_Navigation>(Node)))
+	{
+		return;
+	}
+
+	// Levels are only moved onto a navigation graph actor when its Import Navigation Nodes button is pressed, so say so once per level.
+	if (NodeIndices.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s still uses AI_Navigation actors. Add an AI_NavigationGraph actor to the level and press Import Navigation Nodes to move them into it."),
+			*GetNameSafe(Node->GetLevel() ? Node->GetLevel()->GetOuter() : nullptr))
+	}
+
+	const TObjectKey<AAI_Navigation> NodeKey(Node);
+	const int32 NodeIndex = RegisteredLocations.Add(Node->GetActorLocation());
+	RegisteredAdjacency.AddDefaulted();
+	RegisteredDestinationWeights.Add(Node->DestinationWeight);
+	NodeActors.Add(Node);
+	RemovedNodes.Add(false);
+	NodeIndices.Add(NodeKey, NodeIndex);
+
+	for (AAI_Navigation* AdjacentNode : Node->AdjacentNodes)
+	{
+		// Check if the connected navigation node is not null
+		if (!AdjacentNode)
+		{
+			continue;
+		}
+
+		const TObjectKey<AAI_Navigation> AdjacentKey(AdjacentNode);
+		if (const int32* AdjacentIndex = NodeIndices.Find(AdjacentKey))
+		{
+			RegisteredAdjacency[NodeIndex].Add(*AdjacentIndex);
+		}
+		else
+		{
+			PendingLinks.Add(AdjacentKey, NodeIndex);
+		}
+	}
+
+	// Add the links of the nodes that registered before this one.
+	TArray<int32> LinkedNodes;
+	PendingLinks.MultiFind(NodeKey, LinkedNodes);
+	PendingLinks.Remove(NodeKey);
+	for (const int32 LinkedNode : LinkedNodes)
+	{
+		RegisteredAdjacency[LinkedNode].Add(NodeIndex);
+	}
+
+	bNodesAdded = true;
+}
+
+void UAI_Pathfinding::UnregisterNode(AAI_Navigation* Node)
+{
+	int32 NodeIndex = INDEX_NONE;
+	if (!Node || !NodeIndices.RemoveAndCopyValue(TObjectKey<AAI_Navigation>(Node), NodeIndex))
+	{
+		return;
+	}
+
+	// Forget the links that were waiting for adjacent nodes to register.
+	for (AAI_Navigation* AdjacentNode : Node->AdjacentNodes)
+	{
+		PendingLinks.Remove(TObjectKey<AAI_Navigation>(AdjacentNode), NodeIndex);
+	}
+
+	RemoveNode(NodeIndex);
+}
+
+// The links of a graph actor are already indices within the graph, so its nodes are added as one block.
+void UAI_Pathfinding::RegisterGraph(const AAI_NavigationGraph* Graph)
+{
+	if (!Graph || GraphNodeRanges.Contains(Graph))
+	{
+		return;
+	}
+
+	const int32 FirstNode = RegisteredLocations.Num();
+	Graph->AppendNodes(RegisteredLocations, RegisteredAdjacency);
+	Graph->AppendDestinationWeights(RegisteredDestinationWeights);
+
+	const int32 NumGraphNodes = RegisteredLocations.Num() - FirstNode;
+	NodeActors.AddDefaulted(NumGraphNodes);
+	RemovedNodes.Add(false, NumGraphNodes);
+	GraphNodeRanges.Add(Graph, TPair<int32, int32>(FirstNode, NumGraphNodes));
+
+	bNodesAdded = true;
+}
+
+void UAI_Pathfinding::UnregisterGraph(const AAI_NavigationGraph* Graph)
+{
+	TPair<int32, int32> NodeRange;
+	if (!Graph || !GraphNodeRanges.RemoveAndCopyValue(Graph, NodeRange))
+	{
+		return;
+	}
+
+	for (int32 Node = NodeRange.Key; Node < NodeRange.Key + NodeRange.Value; Node++)
+	{
+		RemoveNode(Node);
+	}
+}
+
+// This is used for when the AI is Free-Roaming.
+// It gets a path between the AI's start location node to a random node in the world.
+TArray<FVector> UAI_Pathfinding::GetRandomPath(const FVector& StartLocation, EAI_SearchMode Mode)
+{
+	const int32 StartNode = GetClosestNode(StartLocation);
+
+	TArray<FVector> NodeLocations;
+	if (GetPath(StartNode, GetRandomReachableNode(StartNode), Mode, PathNodes))
+	{
+		GetNodeLocations(PathNodes, NodeLocations);
+	}
+	return NodeLocations;
+}
+
+// This is used by the AI when it is either Free-Roaming or Chasing the player
+// It gets a path between the AI's start location node to a target node in the world.
+TArray<FVector> UAI_Pathfinding::GetPath(const FVector& StartLocation, const FVector& TargetLocation, EAI_SearchMode Mode)
+{
+	TArray<FVector> NodeLocations;
+	if (GetPath(GetClosestNode(StartLocation), GetClosestNode(TargetLocation), Mode, PathNodes))
+	{
+		GetNodeLocations(PathNodes, NodeLocations);
+	}
+	return NodeLocations;
+}
+
+// This is used when many AI need paths on the same frame.
+// Every closest node is looked up in one batch, then the queries are sorted by goal so the queries heading to the same node are answered together.
+void UAI_Pathfinding::GetPaths(TArrayView<const FAI_PathQuery> Queries, TArrayView<FAI_CompactPath* const> OutPaths, EAI_SearchMode Mode)
+{
+	check(Queries.Num() == OutPaths.Num());
+
+	// The start locations come first, then the target locations.
+	const int32 NumQueries = Queries.Num();
+	TArray<FVector> Locations;
+	Locations.SetNumUninitialized(NumQueries * 2);
+	for (int32 Query = 0; Query < NumQueries; Query++)
+	{
+		Locations[Query] = Queries[Query].StartLocation;
+		Locations[NumQueries + Query] = Queries[Query].TargetLocation;
+	}
+
+	TArray<int32> Nodes;
+	GetClosestNodes(Locations, Nodes);
+
+	TArray<int32> QueryOrder;
+	QueryOrder.SetNumUninitialized(NumQueries);
+	for (int32 Query = 0; Query < NumQueries; Query++)
+	{
+		QueryOrder[Query] = Query;
+	}
+	Algo::Sort(QueryOrder, [&Nodes, NumQueries](int32 A, int32 B)
+	{
+		return Nodes[NumQueries + A] < Nodes[NumQueries + B];
+	});
+
+	for (int32 GroupBegin = 0; GroupBegin < NumQueries;)
+	{
+		const int32 GoalNode = Nodes[NumQueries + QueryOrder[GroupBegin]];
+		int32 GroupEnd = GroupBegin + 1;
+		while (GroupEnd < NumQueries && Nodes[NumQueries + QueryOrder[GroupEnd]] == GoalNode)
+		{
+			GroupEnd++;
+		}
+
+		// A goal shared by enough queries gets a flow field, which answers all of them with one backwards search.
+		// The next node table is cheaper still, so it is used instead whenever it has been built.
+		const FAI_FlowField* FlowField = nullptr;
+		if (GoalNode != INDEX_NONE && GroupEnd - GroupBegin >= BatchFlowFieldMinQueries && !NavGraph->NextHopTable.IsBuiltFor(NavGraph->Version))
+		{
+			FlowField = GetBatchFlowField(GoalNode);
+		}
+
+		for (int32 Index = GroupBegin; Index < GroupEnd; Index++)
+		{
+			const int32 Query = QueryOrder[Index];
+			const int32 StartNode = Nodes[Query];
+			const int32 OccupiedEdge = GetOccupiedEdge(OutPaths[Query]);
+			if (FlowField)
+			{
+				GetFlowFieldPath(*FlowField, StartNode, OccupiedEdge, PathNodes);
+			}
+			else
+			{
+				GetPath(StartNode, GoalNode, Mode, PathNodes, OccupiedEdge);
+			}
+			AssignPath(*OutPaths[Query], PathNodes, NavGraph->Version);
+		}
+
+		GroupBegin = GroupEnd;
+	}
+}
+
+bool UAI_Pathfinding::AreConnected(const FVector& StartLocation, const FVector& TargetLocation)
+{
+	const int32 StartNode = GetClosestNode(StartLocation);
+	const int32 EndNode = GetClosestNode(TargetLocation);
+	return StartNode != INDEX_NONE && EndNode != INDEX_NONE && NavGraph->Components.AreConnected(StartNode, EndNode);
+}
+
+// The agent walks to the first node of the path before it is on any edge of it.
+void UAI_Pathfinding::AssignPath(FAI_CompactPath& Path, const TArray<int32>& InPathNodes, uint32 InGraphVersion)
+{
+	LeaveEdge(Path);
+	PathBuffers.Assign(Path, InPathNodes, InGraphVersion);
+	RequestPathVisibility(Path);
+}
+
+// Node indices keep pointing at the same nodes until the nodes are numbered again, so a path from an older graph can still be walked
+// as long as its next node has not been removed.
+bool UAI_Pathfinding::GetPathWaypoint(const FAI_CompactPath& Path, FVector& OutLocation) const
+{
+	const int32 Node = PathBuffers.GetNode(Path);
+	if (Node == INDEX_NONE || Path.GraphVersion < NavGraph->LayoutVersion || Node >= NavGraph->NumNodes() || NavGraph->IsNodeRemoved(Node))
+	{
+		return false;
+	}
+
+	OutLocation = NavGraph->GetNodeLocation(Node);
+	return true;
+}
+
+// Only pairs whose trace has already finished are used, so smoothing never waits on a trace.
+void UAI_Pathfinding::AdvancePath(FAI_CompactPath& Path)
+{
+	const int32 ReachedNode = PathBuffers.GetNode(Path);
+	Path.Advance();
+
+	// The agent is now walking along the edge from the node it reached to the next node of the path.
+	LeaveEdge(Path);
+	if (ReachedNode != INDEX_NONE && !Path.IsEmpty() && Path.GraphVersion >= NavGraph->LayoutVersion)
+	{
+		EnterEdge(Path, ReachedNode, PathBuffers.GetNode(Path));
+	}
+
+	if (!bSmoothPaths || ReachedNode == INDEX_NONE || Path.GraphVersion < NavGraph->LayoutVersion)
+	{
+		return;
+	}
+
+	// The last node is never skipped, so the AI still ends up where it was heading.
+	for (int32 Step = 0; Step < SmoothingLookahead - 1 && Path.NumRemaining() > 1; Step++)
+	{
+		if (VisibilityCache.Find(ReachedNode, PathBuffers.GetNode(Path, 1)) != EAI_Visibility::Visible)
+		{
+			break;
+		}
+		Path.Advance();
+	}
+}
+
+bool UAI_Pathfinding::GetPathGoal(const FAI_CompactPath& Path, FVector& OutLocation) const
+{
+	if (Path.GoalNode == INDEX_NONE || Path.GraphVersion < NavGraph->LayoutVersion || Path.GoalNode >= NavGraph->NumNodes() || NavGraph->IsNodeRemoved(Path.GoalNode))
+	{
+		return false;
+	}
+
+	OutLocation = NavGraph->GetNodeLocation(Path.GoalNode);
+	return true;
+}
+
+void UAI_Pathfinding::ReleasePath(FAI_CompactPath& Path)
+{
+	LeaveEdge(Path);
+	PathBuffers.Release(Path);
+}
+
+void UAI_Pathfinding::ClearPath(FAI_CompactPath& Path)
+{
+	LeaveEdge(Path);
+	Path.Clear();
+}
+
+// This is used by the AI when it is Chasing the player.
+// Every AI chasing the same player reads its path from the same flow field, so there is only one search per player.
+void UAI_Pathfinding::GetChasePath(const FVector& StartLocation, const AActor* Target, FAI_CompactPath& OutPath)
+{
+	PathNodes.Reset();
+
+	// Everyone chasing the target shares the field, so the edges other chasers are walking along are weighed when reading it.
+	const FAI_FlowField* FlowField = UpdateFlowField(Target);
+	if (FlowField)
+	{
+		GetFlowFieldPath(*FlowField, GetClosestNode(StartLocation), GetOccupiedEdge(&OutPath), PathNodes);
+	}
+
+	AssignPath(OutPath, PathNodes, NavGraph->Version);
+}
+
+// Reads the next node towards a target from its flow field.
+bool UAI_Pathfinding::GetChaseWaypoint(const FVector& Location, const AActor* Target, FVector& OutWaypoint, const FAI_CompactPath* CurrentPath)
+{
+	const FAI_FlowField* FlowField = UpdateFlowField(Target);
+	const int32 Node = GetClosestNode(Location);
+	if (!FlowField || Node == INDEX_NONE || FlowField->GetDistance(Node) == UE_MAX_FLT)
+	{
+		return false;
+	}
+
+	// If the closest node is already the goal, then walk to it.
+	// Otherwise the whole path is read, so going around traffic is decided the same way as for every other path.
+	int32 NextNode = Node;
+	if (Node != FlowField->GoalNode)
+	{
+		GetFlowFieldPath(*FlowField, Node, GetOccupiedEdge(CurrentPath), PathNodes);
+		NextNode = PathNodes[PathNodes.Num() - 2];
+	}
+	OutWaypoint = NavGraph->GetNodeLocation(NextNode);
+	return true;
+}
+
+FAI_IncrementalSearchHandle UAI_Pathfinding::CreateChaseSearch()
+{
+	FAI_IncrementalSearchHandle Handle;
+	Handle.Id = NextChaseSearchId++;
+	ChaseSearches.Add(Handle.Id, MakeUnique<FAI_IncrementalSearch>());
+	return Handle;
+}
+
+void UAI_Pathfinding::ReleaseChaseSearch(FAI_IncrementalSearchHandle& Handle)
+{
+	ChaseSearches.Remove(Handle.Id);
+	Handle.Invalidate();
+}
+
+// This is used by the AI when it is Chasing the player without flow fields.
+// The search keeps its tree between calls, so following a player that moves a node or two costs a few expansions rather than a full search.
+bool UAI_Pathfinding::UpdateChaseSearch(FAI_IncrementalSearchHandle Handle, const FVector& Location, const AActor* Target, bool bForceNewPath, FAI_CompactPath& OutPath)
+{
+	TUniquePtr<FAI_IncrementalSearch>* Search = ChaseSearches.Find(Handle.Id);
+	if (!Search || !Target)
+	{
+		return false;
+	}
+
+	const int32 GoalNode = GetClosestNode(Target->GetActorLocation());
+	const int32 StartNode = GetClosestNode(Location);
+	if (GoalNode == INDEX_NONE || StartNode == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// If the target cannot be reached, then there is no path, and the search would only grow over everything it can reach.
+	if (!NavGraph->Components.AreConnected(StartNode, GoalNode))
+	{
+		(*Search)->Reset();
+		ClearPath(OutPath);
+		return true;
+	}
+
+	// If the target is still at the same node, then the path the AI is following is still the shortest.
+	const bool bGoalMoved = GoalNode != (*Search)->GetGoalNode() || !(*Search)->IsBuiltFor(NavGraph->Version);
+	if (!bGoalMoved && !bForceNewPath)
+	{
+		return false;
+	}
+
+	(*Search)->Replan(*NavGraph, StartNode, GoalNode);
+	(*Search)->GetPath(PathNodes);
+	AssignPath(OutPath, PathNodes, NavGraph->Version);
+	return true;
+}
+
+bool UAI_Pathfinding::UsesHierarchicalPaths() const
+{
+	return HierarchicalGraph.IsBuiltFor(NavGraph->Version);
+}
+
+// This is used for when the AI is Free-Roaming on large maps.
+// Only the small abstract graph between clusters is searched, and the detailed path is filled in as the AI walks it.
+bool UAI_Pathfinding::GetRandomHierarchicalPath(const FVector& StartLocation, FAI_HierarchicalPath& OutPath)
+{
+	const int32 StartNode = GetClosestNode(StartLocation);
+	const int32 EndNode = GetRandomReachableNode(StartNode);
+	if (!UsesHierarchicalPaths() || StartNode == INDEX_NONE || EndNode == INDEX_NONE)
+	{
+		OutPath.Reset();
+		return false;
+	}
+
+	return HierarchicalGraph.FindPath(*NavGraph, StartNode, EndNode, SearchContext, OutPath);
+}
+
+bool UAI_Pathfinding::GetHierarchicalPath(const FVector& StartLocation, const FVector& TargetLocation, FAI_HierarchicalPath& OutPath)
+{
+	const int32 StartNode = GetClosestNode(StartLocation);
+	const int32 EndNode = GetClosestNode(TargetLocation);
+	if (!UsesHierarchicalPaths() || StartNode == INDEX_NONE || EndNode == INDEX_NONE)
+	{
+		OutPath.Reset();
+		return false;
+	}
+
+	return HierarchicalGraph.FindPath(*NavGraph, StartNode, EndNode, SearchContext, OutPath);
+}
+
+// Only the part of the path up to the next cluster is searched, so an AI that changes its mind never pays for the rest.
+bool UAI_Pathfinding::RefineHierarchicalPath(FAI_HierarchicalPath& Path, FAI_CompactPath& OutPath)
+{
+	const bool bRefined = HierarchicalGraph.RefineNextCluster(*NavGraph, Path, SearchContext, PathNodes);
+	AssignPath(OutPath, PathNodes, NavGraph->Version);
+	return bRefined;
+}
+
+// The same as GetRandomPath, but the search runs on a worker thread.
+FAI_PathRequestHandle UAI_Pathfinding::RequestRandomPath(const FVector& StartLocation, FAI_OnPathRequestComplete OnComplete, EAI_SearchMode Mode, EAI_PathRequestPriority Priority,
+	const FAI_CompactPath* CurrentPath)
+{
+	const int32 StartNode = GetClosestNode(StartLocation);
+	return RequestPath(StartNode, GetRandomReachableNode(StartNode), Mode, Priority, GetOccupiedEdge(CurrentPath), MoveTemp(OnComplete));
+}
+
+// The same as GetPath, but the search runs on a worker thread.
+// The closest nodes are found straight away, so only the search itself is done off the game thread.
+FAI_PathRequestHandle UAI_Pathfinding::RequestPath(const FVector& StartLocation, const FVector& TargetLocation, FAI_OnPathRequestComplete OnComplete, EAI_SearchMode Mode, EAI_PathRequestPriority Priority,
+	const FAI_CompactPath* CurrentPath)
+{
+	return RequestPath(GetClosestNode(StartLocation), GetClosestNode(TargetLocation), Mode, Priority, GetOccupiedEdge(CurrentPath), MoveTemp(OnComplete));
+}
+
+EAI_PathRequestStatus UAI_Pathfinding::PollPathRequest(FAI_PathRequestHandle Handle, FAI_CompactPath& OutPath)
+{
+	uint32 PathGraphVersion = 0;
+	const EAI_PathRequestStatus Status = PathRequests->Poll(Handle, PathNodes, PathGraphVersion);
+	if (Status == EAI_PathRequestStatus::Succeeded || Status == EAI_PathRequestStatus::Failed)
+	{
+		AssignPath(OutPath, PathNodes, PathGraphVersion);
+	}
+	return Status;
+}
+
+void UAI_Pathfinding::CancelPathRequest(FAI_PathRequestHandle Handle)
+{
+	PathRequests->Cancel(Handle);
+}
+
+// Gets the path cache counters, together with how many requests shared a search with another request.
+FAI_PathCacheStats UAI_Pathfinding::GetPathCacheStats() const
+{
+	FAI_PathCacheStats Stats;
+	PathCache.GetStats(Stats);
+	Stats.CoalescedRequests = PathRequests->GetNumCoalescedRequests();
+	return Stats;
+}
+
+void UAI_Pathfinding::ResetPathCacheStats()
+{
+	PathCache.ResetStats();
+	PathRequests->ResetCoalescedRequests();
+}
+
+FAI_VisibilityCacheStats UAI_Pathfinding::GetVisibilityCacheStats() const
+{
+	FAI_VisibilityCacheStats Stats;
+	VisibilityCache.GetStats(Stats);
+	return Stats;
+}
+
+void UAI_Pathfinding::ResetVisibilityCacheStats()
+{
+	VisibilityCache.ResetStats();
+}
+
+// Adds the searches run on worker threads to the ones run on the game thread.
+FAI_SearchStats UAI_Pathfinding::GetSearchStats() const
+{
+	FAI_SearchStats Stats;
+	PathRequests->GetSearchStats(Stats);
+	Stats.NumSearches += SearchStats.NumSearches;
+	Stats.ExpandedNodes += SearchStats.ExpandedNodes;
+	return Stats;
+}
+
+void UAI_Pathfinding::ResetSearchStats()
+{
+	SearchStats = FAI_SearchStats();
+	PathRequests->ResetSearchStats();
+}
+
+// Both modes search the same node pairs, so the difference in time and expanded nodes comes only from the search itself.
+// The next node table and the cache are skipped, as they would hide the searches.
+void UAI_Pathfinding::BenchmarkSearchModes(int32 NumQueries)
+{
+	if (NavGraph->NumNodes() == 0 || NumQueries <= 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("There is nothing to benchmark."))
+		return;
+	}
+
+	TArray<TPair<int32, int32>> NodePairs;
+	NodePairs.Reserve(NumQueries);
+	for (int32 Query = 0; Query < NumQueries; Query++)
+	{
+		NodePairs.Emplace(GetRandomNode(), GetRandomNode());
+	}
+
+	for (const EAI_SearchMode Mode : { EAI_SearchMode::Unidirectional, EAI_SearchMode::Bidirectional })
+	{
+		int64 ExpandedNodes = 0;
+		int32 FoundPaths = 0;
+		double PathLength = 0.0;
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (const TPair<int32, int32>& NodePair : NodePairs)
+		{
+			if (SearchPath(NodePair.Key, NodePair.Value, Mode, PathNodes))
+			{
+				FoundPaths++;
+				for (int32 Index = 1; Index < PathNodes.Num(); Index++)
+				{
+					PathLength += FVector::Distance(NavGraph->GetNodeLocation(PathNodes[Index - 1]), NavGraph->GetNodeLocation(PathNodes[Index]));
+				}
+			}
+			ExpandedNodes += SearchContext.LastExpansions;
+		}
+		const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		UE_LOG(LogTemp, Display, TEXT("%s: %d queries, %d paths, %.3f ms per query, %.1f nodes expanded per query, total path length %.0f"),
+			Mode == EAI_SearchMode::Bidirectional ? TEXT("Bidirectional") : TEXT("Unidirectional"),
+			NumQueries, FoundPaths, ElapsedMs / NumQueries, double(ExpandedNodes) / NumQueries, PathLength)
+	}
+}
+
+// The file only matches the nodes as they are numbered when the map is first loaded, so it cannot be cooked once nodes have been removed.
+bool UAI_Pathfinding::SaveCookedGraph()
+{
+	// The file is matched against the registered nodes, so it has to be written from a graph that includes all of them.
+	if (bNodesAdded || bNodesRemoved)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The navigation graph has changes that have not been applied yet. Cook it again on the next frame."))
+		return false;
+	}
+
+	if (NavGraph->NumNodes() == 0 || NumRemovedNodes > 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The navigation graph can only be cooked while it has nodes and none have been removed."))
+		return false;
+	}
+
+	FAI_NavGraphFileWriter File;
+	NavGraph->SaveTo(File);
+	NavGraph->Components.SaveTo(File);
+	if (!NavGraph->Landmarks.IsEmpty())
+	{
+		NavGraph->Landmarks.SaveTo(File);
+	}
+	if (NavGraph->NextHopTable.IsBuiltFor(NavGraph->Version))
+	{
+		NavGraph->NextHopTable.SaveTo(File);
+	}
+
+	const FString Filename = GetCookedGraphFilename();
+	if (!File.Save(Filename, GetRegisteredNodesHash()))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write the cooked navigation graph to %s"), *Filename)
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Cooked %d navigation nodes to %s"), NavGraph->NumNodes(), *Filename)
+	return true;
+}
+
+// Only the parts built from the graph that the changes affect are thrown away.
+// Removing nodes keeps the indices of every other node and can only make paths longer, so the cached paths, landmarks and next node columns
+// that avoid the removed nodes are still correct. Adding nodes or links can make any path shorter, so those are built again.
+// Clusters that a change does not touch, and destination tables that still pick from the same nodes, are kept either way.
+void UAI_Pathfinding::UpdateGraph()
+{
+	if (!bNodesAdded && !bNodesRemoved)
+	{
+		return;
+	}
+
+	bool bRenumbered = false;
+	if (bNodesRemoved)
+	{
+		RemoveLinksToRemovedNodes();
+
+		// Removed nodes still take a slot in every table built from the graph, so once they are most of the nodes, the nodes are numbered again.
+		if (NumRemovedNodes * 2 > RegisteredLocations.Num())
+		{
+			CompactNodes();
+			bRenumbered = true;
+		}
+	}
+
+	const bool bOnlyRemoved = bNodesRemoved && !bNodesAdded && !bRenumbered;
+	bNodesAdded = false;
+	bNodesRemoved = false;
+
+	// The first update runs on the first tick, once every node placed in the map has registered, so only it can match the map's cooked graph file.
+	// Its graph and tables are then read from the file instead of being built. Each part that is missing from the file, or does not fit,
+	// is built as usual. Later updates add streamed or spawned nodes, which the file does not hold, so they never look at it.
+	FAI_NavGraphFileReader CookedGraph;
+	if (bLoadCookedGraph && !bCookedGraphChecked)
+	{
+		bCookedGraphChecked = true;
+		if (NumRemovedNodes == 0)
+		{
+			CookedGraph.Open(GetCookedGraphFilename(), GetRegisteredNodesHash());
+		}
+	}
+
+	// A new snapshot is made rather than changing the old one, because worker threads may still be searching it.
+	// Everything a search reads is built into the snapshot before it is published, and nothing changes it afterwards.
+	const FAI_NavGraphRef OldGraph = NavGraph;
+	const TSharedRef<FAI_NavGraph, ESPMode::ThreadSafe> NewGraph = MakeShared<FAI_NavGraph, ESPMode::ThreadSafe>();
+	const bool bLoadedGraph = CookedGraph.IsOpen() && NewGraph->LoadFrom(CookedGraph, RegisteredLocations.Num());
+	if (!bLoadedGraph)
+	{
+		NewGraph->Build(RegisteredLocations, RegisteredAdjacency);
+	}
+	NewGraph->RemovedNodes = RemovedNodes;
+	NewGraph->Version = ++GraphVersion;
+	NewGraph->LayoutVersion = bRenumbered ? NewGraph->Version : OldGraph->LayoutVersion;
+	NewGraph->SpatialIndex.Build(*NewGraph);
+
+	UE_LOG(LogTemp, Display, TEXT("Updated the navigation graph to version %u with %d nodes (%d removed)%s"), NewGraph->Version, NewGraph->NumNodes() - NumRemovedNodes, NumRemovedNodes,
+		bLoadedGraph ? TEXT(" from its cooked file") : TEXT(""))
+
+	// Label which nodes can reach which, so searches for paths that do not exist never start.
+	if (!bLoadedGraph || !NewGraph->Components.LoadFrom(CookedGraph, NewGraph->NumNodes()))
+	{
+		NewGraph->Components.Build(*NewGraph, MaxReachabilityTableComponents);
+	}
+	UE_LOG(LogTemp, Display, TEXT("Found %d strongly and %d weakly connected components"), NewGraph->Components.NumStrongComponents(), NewGraph->Components.NumWeakComponents())
+
+	// Graphs that will be searched with A* get landmarks, so the searches are guided by real path lengths rather than straight lines.
+	// They are part of the snapshot, so searches on worker threads use them as well.
+	const bool bBuildNextHopTable = bUseNextHopTable && FAI_NextHopTable::CanBuild(NewGraph->NumNodes(), int64(NextHopTableBudgetKB) * 1024);
+	if (!bBuildNextHopTable && NumLandmarks > 0)
+	{
+		// The old distances are never longer than the new ones, so the old landmarks still never overestimate.
+		if (bOnlyRemoved && !OldGraph->Landmarks.IsEmpty())
+		{
+			NewGraph->Landmarks = OldGraph->Landmarks;
+		}
+		else if (bLoadedGraph && NewGraph->Landmarks.LoadFrom(CookedGraph, NewGraph->NumNodes(), NumLandmarks))
+		{
+			UE_LOG(LogTemp, Display, TEXT("Loaded %d landmarks for %d nodes"), NewGraph->Landmarks.Num(), NewGraph->NumNodes())
+		}
+		else
+		{
+			NewGraph->Landmarks.Build(*NewGraph, NumLandmarks);
+			UE_LOG(LogTemp, Display, TEXT("Picked %d landmarks for %d nodes"), NewGraph->Landmarks.Num(), NewGraph->NumNodes())
+		}
+	}
+
+	// Small graphs get a table of the next node between every pair of nodes, so their paths never need a search.
+	if (!bBuildNextHopTable)
+	{
+		NewGraph->NextHopTable.Empty();
+	}
+	// The new snapshot takes over the old table, which shares its entries rather than copying them, and only the stale columns are written again.
+	else if (bOnlyRemoved && OldGraph->NextHopTable.IsBuiltFor(OldGraph->Version))
+	{
+		NewGraph->NextHopTable = OldGraph->NextHopTable;
+		NewGraph->NextHopTable.Update(*NewGraph);
+	}
+	else if (bLoadedGraph && NewGraph->NextHopTable.LoadFrom(CookedGraph, *NewGraph))
+	{
+		UE_LOG(LogTemp, Display, TEXT("Loaded the next node table for %d nodes"), NewGraph->NumNodes())
+	}
+	else
+	{
+		NewGraph->NextHopTable.Build(*NewGraph);
+		UE_LOG(LogTemp, Display, TEXT("Built the next node table for %d nodes (%lld KB)"), NewGraph->NumNodes(), FAI_NextHopTable::GetMemorySize(NewGraph->NumNodes()) / 1024)
+	}
+
+	NavGraph = NewGraph;
+
+	// The edges are numbered again with every version, so the enemies are counted again as they move on to their next edge.
+	EdgeOccupancy.Reset();
+	if (CongestionWeight > 0.0f)
+	{
+		EdgeOccupancy = MakeShared<FAI_EdgeOccupancy, ESPMode::ThreadSafe>(*NavGraph, CongestionWeight);
+	}
+
+	if (bOnlyRemoved)
+	{
+		PathCache.KeepPathsAvoiding(RemovedNodes, NavGraph->Version);
+	}
+
+	// If the edges are the same, such as when only unlinked nodes were removed, then the incremental searches only need to redo
+	// the edges whose lengths changed. Otherwise they start again on their next update.
+	if (OldGraph->EdgeOffsets == NavGraph->EdgeOffsets && OldGraph->Neighbours == NavGraph->Neighbours)
+	{
+		TArray<int32> ChangedEdges;
+		for (int32 Edge = 0; Edge < NavGraph->NumEdges(); Edge++)
+		{
+			if (OldGraph->EdgeLengths[Edge] != NavGraph->EdgeLengths[Edge])
+			{
+				ChangedEdges.Add(Edge);
+			}
+		}
+		for (const TPair<uint32, TUniquePtr<FAI_IncrementalSearch>>& Search : ChaseSearches)
+		{
+			if (Search.Value->IsBuiltFor(OldGraph->Version))
+			{
+				Search.Value->UpdateEdges(*NavGraph, ChangedEdges);
+			}
+		}
+	}
+
+	// The destination weights never change on their own, so the tables only need building when the nodes that can be picked,
+	// or the weak components they are in, have changed.
+	if (!DestinationSampler.IsUpToDate(*NavGraph, RegisteredDestinationWeights))
+	{
+		DestinationSampler.Build(*NavGraph, RegisteredDestinationWeights);
+	}
+
+	// Large graphs that are too big for the table are split into clusters instead.
+	// Only the clusters with nodes whose edges changed are searched again.
+	if (bUseHierarchicalPathfinding && !NavGraph->NextHopTable.IsBuiltFor(NavGraph->Version) && NavGraph->NumNodes() >= HierarchicalMinNodes)
+	{
+		HierarchicalGraph.Update(*OldGraph, *NavGraph, HierarchicalClusterSize);
+		UE_LOG(LogTemp, Display, TEXT("Split %d nodes into %d clusters with %d entrances"), NavGraph->NumNodes(), HierarchicalGraph.NumClusters(), HierarchicalGraph.NumEntrances())
+	}
+	else
+	{
+		HierarchicalGraph.Empty();
+	}
+}
+
+// The node's actor is kept until the links to it are dropped, so they can wait for the actor in case it registers again.
+void UAI_Pathfinding::RemoveNode(int32 Node)
 {
-	PopulateNodes();
+	if (RemovedNodes[Node])
+	{
+		return;
+	}
+
+	RegisteredAdjacency[Node].Empty();
+	RemovedNodes[Node] = true;
+	NumRemovedNodes++;
+	bNodesRemoved = true;
 }
 
-// This is used for when the AI is Free-Roaming.
-// It gets a path between the AI's start location node to a random node in the world.
-TArray<FVector> UAI_Pathfinding::GetRandomPath(const FVector& StartLocation)
+// Every removal since the last update is handled in one pass over the links, however many nodes were removed.
+void UAI_Pathfinding::RemoveLinksToRemovedNodes()
 {
-	return GetPath(GetClosestNode(StartLocation), GetRandomNode());
+	TArray<int32> RelinkedNodes;
+	for (int32 Node = 0; Node < RegisteredAdjacency.Num(); Node++)
+	{
+		RelinkedNodes.Reset();
+		RegisteredAdjacency[Node].RemoveAll([this, Node, &RelinkedNodes](int32 AdjacentNode)
+		{
+			if (!RemovedNodes[AdjacentNode])
+			{
+				return false;
+			}
+
+			// A link between two node actors is added again if the removed actor comes back. An actor that has been destroyed never comes back.
+			const AAI_Navigation* AdjacentActor = NodeActors[AdjacentNode].Get();
+			if (NodeActors[Node].IsValid() && AdjacentActor)
+			{
+				const TObjectKey<AAI_Navigation> AdjacentKey(AdjacentActor);
+				if (const int32* AdjacentIndex = NodeIndices.Find(AdjacentKey))
+				{
+					RelinkedNodes.Add(*AdjacentIndex);
+					bNodesAdded = true;
+				}
+				else
+				{
+					PendingLinks.Add(AdjacentKey, Node);
+				}
+			}
+			return true;
+		});
+		RegisteredAdjacency[Node].Append(RelinkedNodes);
+	}
+
+	for (TConstSetBitIterator<> It(RemovedNodes); It; ++It)
+	{
+		NodeActors[It.GetIndex()].Reset();
+	}
 }
 
-// This is used by the AI when it is either Free-Roaming or Chasing the player
-// It gets a path between the AI's start location node to a target node in the world.
-TArray<FVector> UAI_Pathfinding::GetPath(const FVector& StartLocation, const FVector& TargetLocation)
+void UAI_Pathfinding::CompactNodes()
 {
-	return GetPath(GetClosestNode(StartLocation), GetClosestNode(TargetLocation));
+	TArray<int32> NewIndices;
+	NewIndices.Init(INDEX_NONE, RegisteredLocations.Num());
+
+	int32 NumNodes = 0;
+	for (int32 Node = 0; Node < RegisteredLocations.Num(); Node++)
+	{
+		if (RemovedNodes[Node])
+		{
+			continue;
+		}
+
+		NewIndices[Node] = NumNodes;
+		if (NumNodes != Node)
+		{
+			RegisteredLocations[NumNodes] = RegisteredLocations[Node];
+			RegisteredAdjacency[NumNodes] = MoveTemp(RegisteredAdjacency[Node]);
+			RegisteredDestinationWeights[NumNodes] = RegisteredDestinationWeights[Node];
+			NodeActors[NumNodes] = NodeActors[Node];
+		}
+		NumNodes++;
+	}
+
+	RegisteredLocations.SetNum(NumNodes);
+	RegisteredAdjacency.SetNum(NumNodes);
+	RegisteredDestinationWeights.SetNum(NumNodes);
+	NodeActors.SetNum(NumNodes);
+	RemovedNodes.Init(false, NumNodes);
+	NumRemovedNodes = 0;
+
+	// The links to removed nodes have already been dropped, so every index left belongs to a node that is kept.
+	for (TArray<int32>& AdjacentNodes : RegisteredAdjacency)
+	{
+		for (int32& AdjacentNode : AdjacentNodes)
+		{
+			AdjacentNode = NewIndices[AdjacentNode];
+		}
+	}
+	for (TPair<TObjectKey<AAI_Navigation>, int32>& NodeIndex : NodeIndices)
+	{
+		NodeIndex.Value = NewIndices[NodeIndex.Value];
+	}
+	for (TPair<TObjectKey<AAI_Navigation>, int32>& PendingLink : PendingLinks)
+	{
+		PendingLink.Value = NewIndices[PendingLink.Value];
+	}
+	for (TPair<const AAI_NavigationGraph*, TPair<int32, int32>>& NodeRange : GraphNodeRanges)
+	{
+		// A graph without nodes starts past the last node, so its start is moved to the end instead.
+		NodeRange.Value.Key = NodeRange.Value.Value > 0 ? NewIndices[NodeRange.Value.Key] : NumNodes;
+	}
 }
 
-// Adds all navigation nodes from the world into the Navigation nodes list variable.
-void UAI_Pathfinding::PopulateNodes()
+// Cooked graphs sit with the content, in a folder that is staged as loose files so that their sections are read straight from disk.
+FString UAI_Pathfinding::GetCookedGraphFilename() const
 {
-	NavigationNodes.Empty();
+	const FString MapName = UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+	return FPaths::ProjectContentDir() / TEXT("NavGraphs") / (MapName + TEXT(".aigraph"));
+}
 
-	for (TActorIterator<AAI_Navigation> It(GetWorld()); It; ++It)
+// The number of links of each node is hashed before its links, so moving a link from one node to the next changes the hash.
+uint64 UAI_Pathfinding::GetRegisteredNodesHash() const
+{
+	uint64 Hash = CityHash64WithSeed(reinterpret_cast<const char*>(RegisteredLocations.GetData()), RegisteredLocations.Num() * sizeof(FVector), RegisteredLocations.Num());
+	for (const TArray<int32>& AdjacentNodes : RegisteredAdjacency)
 	{
-		NavigationNodes.Add(*It);
+		const int32 NumLinks = AdjacentNodes.Num();
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&NumLinks), sizeof(NumLinks), Hash);
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(AdjacentNodes.GetData()), NumLinks * sizeof(int32), Hash);
 	}
+	return Hash;
 }
 
 // Gets a random navigation node in the world.
-AAI_Navigation* UAI_Pathfinding::GetRandomNode()
+int32 UAI_Pathfinding::GetRandomNode()
 {
 	// If the list is empty, then do nothing.
-	if (NavigationNodes.Num() == 0)
+	if (NavGraph->NumNodes() == 0)
 	{
 		UE_LOG(LogTemp, Error, TEXT("The nodes array is empty."))
-		return nullptr;
+		return INDEX_NONE;
 	}
 
-	// Choose a random index which will be used to access a node from the NavigationNodes list.
-	const int32 RandIndex = FMath::RandRange(0, NavigationNodes.Num()-1);
-	return NavigationNodes[RandIndex];
+	// Choose a random index which will be used to access a node from the navigation graph.
+	return FMath::RandRange(0, NavGraph->NumNodes()-1);
 }
 
-// Get the closest navigation node from a target location
-AAI_Navigation* UAI_Pathfinding::GetClosestNode(const FVector& TargetLocation)
+// Gets a random navigation node that the start node has a path to, so a random path never fails because the node is on an island.
+// The draws come from the start node's weak component, then each is kept with a chance that falls for nodes outside the preferred distances
+// and nodes picked recently. One-way edges can still leave a drawn node out of reach, so those are always drawn again.
+int32 UAI_Pathfinding::GetRandomReachableNode(int32 StartNode)
 {
-	// If the list is empty, then do nothing.
-	if (NavigationNodes.Num() == 0)
+	if (StartNode == INDEX_NONE)
 	{
-		UE_LOG(LogTemp, Error, TEXT("The nodes array is empty."))
-		return nullptr;
+		return INDEX_NONE;
 	}
 
-	// Setting the closest node to null and the minimum distance to the maximum float.
-	// This is to ensure that our distance between the target and node is smaller than this number.
-	AAI_Navigation* ClosestNode = nullptr;
-	float MinDistance = UE_MAX_FLT;
-
-	// For each node in the list, check if the distance between the target location and the node location is shorter than the previous nodes in the list.
-	for (AAI_Navigation* Node : NavigationNodes)
+	const double Time = GetWorld()->GetTimeSeconds();
+	const int32 WeakComponent = NavGraph->Components.GetWeakComponent(StartNode);
+	int32 FallbackNode = INDEX_NONE;
+	float FallbackScore = -1.0f;
+	for (int32 Attempt = 0; Attempt < DestinationSampleAttempts; Attempt++)
 	{
-		const float Distance = FVector::Distance(TargetLocation, Node->GetActorLocation());
+		const int32 Node = DestinationSampler.Sample(WeakComponent);
+		if (Node == INDEX_NONE)
+		{
+			break;
+		}
+		if (Node == StartNode || !NavGraph->Components.AreConnected(StartNode, Node))
+		{
+			continue;
+		}
+
+		const float Distance = NavGraph->GetDistance(StartNode, Node);
+		const float RangeChance = Distance >= DestinationMinDistance && Distance <= DestinationMaxDistance ? 1.0f : OutOfRangeDestinationChance;
+		const float Score = RangeChance * DestinationSampler.GetRecencyFactor(Node, Time, DestinationRecencySeconds, DestinationRecencyPenalty);
+		if (FMath::FRand() < Score)
+		{
+			DestinationSampler.MarkPicked(Node, Time);
+			return Node;
+		}
 
-		// If the new distance is smaller than the minimum distance, then set the new value of MinDistance and the closest node.
-		if (Distance < MinDistance)
+		// If every node drawn is turned down, then the one that came closest to being kept is used.
+		if (Score > FallbackScore)
 		{
-			MinDistance = Distance;
-			ClosestNode = Node;
+			FallbackNode = Node;
+			FallbackScore = Score;
 		}
 	}
 
-	return ClosestNode;
+	// If no node with weight other than the start node could be drawn, then there is nowhere to free roam to.
+	if (FallbackNode == INDEX_NONE)
+	{
+		return INDEX_NONE;
+	}
+
+	DestinationSampler.MarkPicked(FallbackNode, Time);
+	return FallbackNode;
+}
+
+// Get the closest navigation node from a target location
+int32 UAI_Pathfinding::GetClosestNode(const FVector& TargetLocation)
+{
+	// If the list is empty, then do nothing.
+	if (NavGraph->SpatialIndex.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("The nodes array is empty."))
+		return INDEX_NONE;
+	}
+
+	// The spatial index skips every part of the map that cannot hold a closer node.
+	return NavGraph->SpatialIndex.FindClosestNode(TargetLocation);
 }
 
 // Get the furthest navigation node from a target location
-AAI_Navigation* UAI_Pathfinding::GetFurthestNode(const FVector& TargetLocation)
+int32 UAI_Pathfinding::GetFurthestNode(const FVector& TargetLocation)
 {
 	// If the list is empty, then do nothing.
-	if (NavigationNodes.Num() == 0)
+	if (NavGraph->SpatialIndex.IsEmpty())
 	{
 		UE_LOG(LogTemp, Error, TEXT("The nodes array is empty."))
-		return nullptr;
+		return INDEX_NONE;
 	}
 
-	// Setting the furthest node to null and the maximum distance to the minimum float.
-	// This is to ensure that our distance between the target and node is larger than this number.
-	AAI_Navigation* FurthestNode = nullptr;
-	float MaxDistance = -1.0f;
+	// The spatial index skips every part of the map that cannot hold a further node.
+	return NavGraph->SpatialIndex.FindFurthestNode(TargetLocation);
+}
+
+// Get the closest navigation node for many target locations in one go
+void UAI_Pathfinding::GetClosestNodes(TArrayView<const FVector> TargetLocations, TArray<int32>& OutNodes)
+{
+	OutNodes.Init(INDEX_NONE, TargetLocations.Num());
 
-	// For each node in the list, check if the distance between the target location and the node location is longer than the previous nodes in the list.
-	for (AAI_Navigation* Node : NavigationNodes)
+	// If the list is empty, then do nothing.
+	if (NavGraph->SpatialIndex.IsEmpty())
 	{
-		const float Distance = FVector::Distance(TargetLocation, Node->GetActorLocation());
-		
-		// If the new distance is larger than the minimum distance, then set the new value of MaxDistance and the furthest node.
-		if (Distance > MaxDistance)
-		{
-			MaxDistance = Distance;
-			FurthestNode = Node;
-		}
+		UE_LOG(LogTemp, Error, TEXT("The nodes array is empty."))
+		return;
 	}
 
-	return FurthestNode;
+	NavGraph->SpatialIndex.FindClosestNodes(TargetLocations, OutNodes);
 }
 
 // Gets a path between the start and end navigation node
-TArray<FVector> UAI_Pathfinding::GetPath(AAI_Navigation* StartNode, AAI_Navigation* EndNode)
+bool UAI_Pathfinding::GetPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, TArray<int32>& OutNodes, int32 IgnoredEdge)
 {
+	OutNodes.Reset();
+
+	// Check if either nodes are missing.
+	if (StartNode == INDEX_NONE || EndNode == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Either the start or end node are missing."))
+		return false;
+	}
 
-	// Check if either nodes are empty or null.
-	if (!StartNode || !EndNode)
+	// If there is no path between the nodes, then return straight away rather than searching everything the start node can reach.
+	if (!NavGraph->Components.AreConnected(StartNode, EndNode))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Either the start or end node are nullptrs."))
-		return TArray<FVector>();
+		return false;
 	}
 
-	// Setup the open set and add the start node.
-	TArray<AAI_Navigation*> OpenSet;
-	OpenSet.Add(StartNode);
+	// If the graph is small enough to have a next node table, then read the shortest path from it without searching.
+	if (NavGraph->NextHopTable.IsBuiltFor(NavGraph->Version))
+	{
+		if (!NavGraph->NextHopTable.GetPath(StartNode, EndNode, OutNodes))
+		{
+			return false;
+		}
+	}
+
+	// If this path has been searched before on the same graph, then reuse it.
+	else if (const TArray<int32>* CachedPath = PathCache.Find(StartNode, EndNode, NavGraph->Version))
+	{
+		OutNodes = *CachedPath;
+	}
+
+	// Otherwise search for the shortest path, whatever enemies are on it, so it can be cached and reused once they have moved on.
+	// If there is no path, then the empty array is cached too, so the same failed search is not repeated.
+	else
+	{
+		if (SearchPath(StartNode, EndNode, Mode, OutNodes))
+		{
+			UE_LOG(LogTemp, Display, TEXT("A path has been found"))
+		}
+		PathCache.Add(StartNode, EndNode, NavGraph->Version, OutNodes);
+	}
 
-	// StartNode->GScore = UE_MAX_FLT;
-	// StartNode->HScore = FVector::Distance(StartNode->GetActorLocation(), EndNode->GetActorLocation());
+	// Only if the enemies on the shortest path make it cost enough more does a search look for a way around them.
+	const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> Congestion = GetPathCongestion(OutNodes, IgnoredEdge);
+	if (!Congestion)
+	{
+		return !OutNodes.IsEmpty();
+	}
 
-	// Setup the maps that will hold the GScores, HScores and CameFrom
-	TMap<AAI_Navigation*, float> GScores, HScores;
-	TMap<AAI_Navigation*, AAI_Navigation*> CameFrom;
+	// A path that went around busy edges is only the best one while they stay busy, so it is not cached.
+	SearchContext.EdgeOccupancy = Congestion.Get();
+	SearchContext.IgnoredEdge = IgnoredEdge;
+	const bool bFoundPath = SearchPath(StartNode, EndNode, Mode, OutNodes);
+	SearchContext.EdgeOccupancy = nullptr;
+	SearchContext.IgnoredEdge = INDEX_NONE;
+	return bFoundPath;
+}
 
-	// Setup the start nodes G and H score.
-	GScores.Add(StartNode, 0);
-	HScores.Add(StartNode, FVector::Distance(StartNode->GetActorLocation(), EndNode->GetActorLocation()));
-	CameFrom.Add(StartNode, nullptr);
+// Runs a search without looking at the next node table or the cache, and counts the nodes it expanded.
+bool UAI_Pathfinding::SearchPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, TArray<int32>& OutNodes)
+{
+	OutNodes.Reset();
 
-	// loop while the OpenSet list is not empty
-	while (!OpenSet.IsEmpty())
+	bool bFoundPath = false;
+	if (ResolveSearchMode(Mode) == EAI_SearchMode::Bidirectional)
 	{
-		// Find the node in the open set with the lowest FScore.
-		AAI_Navigation* CurrentNode = OpenSet[0];
-		for (int32 i = 1; i < OpenSet.Num(); i++)
+		bFoundPath = SearchContext.FindPathBidirectional(*NavGraph, StartNode, EndNode, BackwardSearchContext);
+		if (bFoundPath)
 		{
-			// We can be sure that all the nodes in the open set have already had their GScores and HScores calculated.
-			if (GScores[OpenSet[i]] + HScores[OpenSet[i]] < GScores[CurrentNode] + HScores[CurrentNode])
-			{
-				CurrentNode = OpenSet[i];
-			}
+			SearchContext.ReconstructBidirectionalPath(BackwardSearchContext, OutNodes);
+		}
+	}
+	else
+	{
+		bFoundPath = SearchContext.FindPath(*NavGraph, StartNode, EndNode);
+		if (bFoundPath)
+		{
+			// Reconstruct the path by following the nodes back from the end node.
+			SearchContext.ReconstructPath(EndNode, OutNodes);
 		}
+	}
 
-		// Remove the current node from the OpenSet list
-		OpenSet.Remove(CurrentNode);
+	SearchStats.NumSearches++;
+	SearchStats.ExpandedNodes += SearchContext.LastExpansions;
+	return bFoundPath;
+}
+
+// The shortest path is only left when the enemies on it make it cost more than CongestionReplanMargin more than its length, as no way around them
+// can save more than that. The path is costed with the same edge costs the searches and flow fields use, so the enemy asking is never held up by itself.
+// The nodes run from the end of the path back to its start, so each edge leads from the later node to the earlier one.
+TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> UAI_Pathfinding::GetPathCongestion(const TArray<int32>& ShortestPath, int32 IgnoredEdge) const
+{
+	if (!EdgeOccupancy || EdgeOccupancy->GetGraphVersion() != NavGraph->Version || ShortestPath.Num() < 2)
+	{
+		return nullptr;
+	}
+
+	// While no other enemy is on any edge, every edge costs its length.
+	const int32 OwnOccupants = IgnoredEdge != INDEX_NONE && EdgeOccupancy->GetOccupants(IgnoredEdge) > 0 ? 1 : 0;
+	if (EdgeOccupancy->GetTotalOccupants() <= OwnOccupants)
+	{
+		return nullptr;
+	}
 
-		if (CurrentNode == EndNode)
+	float Length = 0.0f;
+	float CongestedCost = 0.0f;
+	for (int32 Index = ShortestPath.Num() - 1; Index > 0; Index--)
+	{
+		const int32 Edge = NavGraph->FindEdge(ShortestPath[Index], ShortestPath[Index - 1]);
+		if (Edge != INDEX_NONE)
 		{
-			// Reconstruct the path and get the positions of each of the nodes in the path.
-			UE_LOG(LogTemp, Display, TEXT("A path has been found"))
-			return ReconstructPath(CameFrom, EndNode);
+			Length += NavGraph->EdgeLengths[Edge];
+			CongestedCost += EdgeOccupancy->GetEdgeCost(*NavGraph, Edge, IgnoredEdge);
 		}
+	}
+
+	if (CongestedCost <= Length * (1.0f + CongestionReplanMargin))
+	{
+		return nullptr;
+	}
+	return EdgeOccupancy;
+}
+
+int32 UAI_Pathfinding::GetOccupiedEdge(const FAI_CompactPath* Path) const
+{
+	return Path && EdgeOccupancy && EdgeOccupancy->GetGraphVersion() == Path->OccupiedGraphVersion ? Path->OccupiedEdge : INDEX_NONE;
+}
+
+void UAI_Pathfinding::GetFlowFieldPath(const FAI_FlowField& FlowField, int32 StartNode, int32 IgnoredEdge, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+	if (StartNode == INDEX_NONE || !FlowField.GetPath(StartNode, OutNodes))
+	{
+		return;
+	}
+
+	if (const TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> Congestion = GetPathCongestion(OutNodes, IgnoredEdge))
+	{
+		FlowField.GetPathAroundTraffic(*NavGraph, *Congestion, IgnoredEdge, StartNode, OutNodes);
+	}
+}
+
+void UAI_Pathfinding::EnterEdge(FAI_CompactPath& Path, int32 FromNode, int32 ToNode) const
+{
+	if (!EdgeOccupancy || FromNode >= NavGraph->NumNodes() || ToNode >= NavGraph->NumNodes())
+	{
+		return;
+	}
+
+	const int32 Edge = NavGraph->FindEdge(FromNode, ToNode);
+	if (Edge != INDEX_NONE)
+	{
+		EdgeOccupancy->Enter(Edge);
+		Path.OccupiedEdge = Edge;
+		Path.OccupiedGraphVersion = EdgeOccupancy->GetGraphVersion();
+	}
+}
+
+// A path counted on the counters of an older graph version has nothing to take back, as those counters are gone.
+void UAI_Pathfinding::LeaveEdge(FAI_CompactPath& Path) const
+{
+	if (Path.OccupiedEdge != INDEX_NONE && EdgeOccupancy && EdgeOccupancy->GetGraphVersion() == Path.OccupiedGraphVersion)
+	{
+		EdgeOccupancy->Leave(Path.OccupiedEdge);
+	}
+	Path.OccupiedEdge = INDEX_NONE;
+}
+
+void UAI_Pathfinding::GetNodeLocations(const TArray<int32>& Nodes, TArray<FVector>& OutLocations) const
+{
+	OutLocations.Reset(Nodes.Num());
+	for (const int32 Node : Nodes)
+	{
+		OutLocations.Add(NavGraph->GetNodeLocation(Node));
+	}
+}
+
+EAI_SearchMode UAI_Pathfinding::ResolveSearchMode(EAI_SearchMode Mode) const
+{
+	if (Mode == EAI_SearchMode::Default)
+	{
+		return bPreferBidirectionalSearch ? EAI_SearchMode::Bidirectional : EAI_SearchMode::Unidirectional;
+	}
+	return Mode;
+}
+
+// The closest node of each target is only looked up once per frame, however many enemies are chasing it.
+const FAI_FlowField* UAI_Pathfinding::UpdateFlowField(const AActor* Target)
+{
+	if (!Target || NavGraph->NumNodes() == 0)
+	{
+		return nullptr;
+	}
+
+	FAI_FlowField& FlowField = FlowFields.FindOrAdd(Target);
+	if (FlowField.LastUpdateFrame == GFrameCounter && FlowField.GraphVersion == NavGraph->Version)
+	{
+		return &FlowField;
+	}
+	FlowField.LastUpdateFrame = GFrameCounter;
+
+	// Only search again if the target has moved to a different node, or the graph has changed.
+	const int32 GoalNode = GetClosestNode(Target->GetActorLocation());
+	if (!FlowField.IsBuiltFor(GoalNode, NavGraph->Version))
+	{
+		FlowField.Build(*NavGraph, GoalNode, SearchContext);
+	}
+
+	return &FlowField;
+}
+
+// Every pair AdvancePath could ask about is traced as soon as the path is given out, so the results are in by the time the AI gets there.
+// Only static geometry blocks the traces, so the results hold for as long as the nodes keep their indices.
+void UAI_Pathfinding::RequestPathVisibility(const FAI_CompactPath& Path)
+{
+	UWorld* World = GetWorld();
+	if (!bSmoothPaths || !World || Path.GraphVersion < NavGraph->LayoutVersion)
+	{
+		return;
+	}
+
+	VisibilityCache.CheckLayoutVersion(NavGraph->LayoutVersion);
 
-		// For each node in the adjacent node list:
-		for (AAI_Navigation* AdjacentNode : CurrentNode->AdjacentNodes)
+	const FVector TraceOffset(0.0f, 0.0f, VisibilityTraceHeight);
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AI_PathVisibility));
+
+	for (int32 From = 0; From < Path.NumRemaining() - 2; From++)
+	{
+		const int32 FromNode = PathBuffers.GetNode(Path, From);
+		for (int32 To = From + 2; To <= From + SmoothingLookahead && To < Path.NumRemaining(); To++)
 		{
-			// Check if the connected navigation node is not null
-			if (!AdjacentNode)
+			const int32 ToNode = PathBuffers.GetNode(Path, To);
+			if (VisibilityCache.MarkPending(FromNode, ToNode))
 			{
-				continue;
+				FTraceDelegate OnTraceDone = FTraceDelegate::CreateUObject(this, &UAI_Pathfinding::OnVisibilityTraceDone, FAI_VisibilityCache::MakeKey(FromNode, ToNode), NavGraph->LayoutVersion);
+				World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, NavGraph->GetNodeLocation(FromNode) + TraceOffset, NavGraph->GetNodeLocation(ToNode) + TraceOffset,
+					ObjectParams, QueryParams, &OnTraceDone);
 			}
-			
-			const float TentativeGScore = GScores[CurrentNode] + FVector::Distance(CurrentNode->GetActorLocation(), AdjacentNode->GetActorLocation());
+		}
+	}
+}
 
-			// Check if the adjacent node doesn't have a GScore, then set the values of the GScores, HScores and CameFrom variables
-			if (!GScores.Contains(AdjacentNode))
-			{
-				GScores.Add(AdjacentNode, UE_MAX_FLT);
-				HScores.Add(AdjacentNode, FVector::Distance(AdjacentNode->GetActorLocation(), EndNode->GetActorLocation()));
-				CameFrom.Add(AdjacentNode, nullptr);
-			}
+void UAI_Pathfinding::OnVisibilityTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint64 Key, uint32 TraceLayoutVersion)
+{
+	VisibilityCache.SetResult(Key, TraceLayoutVersion, FHitResult::GetFirstBlockingHit(Datum.OutHits) == nullptr);
+}
 
-			// If the TentativeGScore is less than the current g score, then update this nodes scores and came from.
-			if (TentativeGScore < GScores[AdjacentNode])
-			{
-				CameFrom[AdjacentNode] = CurrentNode;
-				GScores[AdjacentNode] = TentativeGScore;
-				
-				// If the adjacent node isn't already in the Open set list, then add connected node to the open set.
-				if (!OpenSet.Contains(AdjacentNode))
-				{
-					OpenSet.Add(AdjacentNode);
-				}
-			}
+// The flow fields of chased targets are kept up to date every frame, so one of them may already lead to the goal.
+const FAI_FlowField* UAI_Pathfinding::GetBatchFlowField(int32 GoalNode)
+{
+	for (const TPair<TWeakObjectPtr<const AActor>, FAI_FlowField>& Pair : FlowFields)
+	{
+		if (Pair.Value.IsBuiltFor(GoalNode, NavGraph->Version))
+		{
+			return &Pair.Value;
 		}
 	}
 
-	// If the OpenSet list is empty, then just return an empty array.
-	return TArray<FVector>();
-	
+	if (!BatchFlowField.IsBuiltFor(GoalNode, NavGraph->Version))
+	{
+		BatchFlowField.Build(*NavGraph, GoalNode, SearchContext);
+	}
+	return &BatchFlowField;
 }
 
-// Reconstructs a path using a node from where the path comes from and to which node the path should end.
-TArray<FVector> UAI_Pathfinding::ReconstructPath(const TMap<AAI_Navigation*, AAI_Navigation*>& CameFromMap, AAI_Navigation* EndNode)
+// Gets a path from the next node table or the cache straight away, or starts a search on a worker thread.
+FAI_PathRequestHandle UAI_Pathfinding::RequestPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, EAI_PathRequestPriority Priority, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete)
 {
-	TArray<FVector> NodeLocations;
+	TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> Congestion;
+	if (StartNode != INDEX_NONE && EndNode != INDEX_NONE)
+	{
+		// A path that does not exist fails on the next tick without a search.
+		if (!NavGraph->Components.AreConnected(StartNode, EndNode))
+		{
+			return PathRequests->SubmitFinished(TArray<int32>(), NavGraph->Version, MoveTemp(OnComplete));
+		}
+
+		// Like GetPath, the shortest path from the table or the cache is used unless the enemies on it make it cost enough more.
+		const TArray<int32>* ShortestPath = nullptr;
+		if (NavGraph->NextHopTable.IsBuiltFor(NavGraph->Version))
+		{
+			ShortestPath = NavGraph->NextHopTable.GetPath(StartNode, EndNode, PathNodes) ? &PathNodes : nullptr;
+		}
+		else
+		{
+			ShortestPath = PathCache.Find(StartNode, EndNode, NavGraph->Version);
+		}
 
-	const AAI_Navigation* NextNode = EndNode;
+		// Only a path the table or the cache already knows is searched around. Otherwise the shortest path is searched for, so it gets cached.
+		if (ShortestPath)
+		{
+			Congestion = GetPathCongestion(*ShortestPath, IgnoredEdge);
+			if (!Congestion)
+			{
+				return PathRequests->SubmitFinished(*ShortestPath, NavGraph->Version, MoveTemp(OnComplete));
+			}
+		}
+	}
 
-	// While the next node is still the ending node, add its location to a list.
-	while(NextNode)
+	if (bTimeSliceSearches)
 	{
-		NodeLocations.Push(NextNode->GetActorLocation());
-		NextNode = CameFromMap[NextNode];
+		return PathRequests->SubmitTimeSliced(NavGraph, StartNode, EndNode, Priority, Congestion, IgnoredEdge, MoveTemp(OnComplete));
 	}
 
-	return NodeLocations;
+	return PathRequests->Submit(NavGraph, StartNode, EndNode, ResolveSearchMode(Mode), Congestion, IgnoredEdge, MoveTemp(OnComplete));
 }
-
@@ -3,52 +3,478 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "AI_Navigation.h"
+#include "AI_DestinationSampler.h"
+#include "AI_EdgeOccupancy.h"
+#include "AI_FlowField.h"
+#include "AI_HierarchicalGraph.h"
+#include "AI_IncrementalSearch.h"
+#include "AI_NavGraph.h"
+#include "AI_PathBufferPool.h"
+#include "AI_PathCache.h"
+#include "AI_PathRequestQueue.h"
+#include "AI_PathSearch.h"
+#include "AI_VisibilityCache.h"
 #include "AI_Pathfinding.generated.h"
 
 // Reference to the AI_Navigation class
 class AAI_Navigation;
+class AAI_NavigationGraph;
+struct FTraceHandle;
+struct FTraceDatum;
 
-UCLASS()
-class FIRSTPERSONTEST_API UAI_Pathfinding : public UWorldSubsystem
+// A path wanted by one agent, answered together with others by UAI_Pathfinding::GetPaths
+struct FIRSTPERSONTEST_API FAI_PathQuery
+{
+	// Where the path starts.
+	FVector StartLocation = FVector::ZeroVector;
+
+	// Where the path should lead to.
+	FVector TargetLocation = FVector::ZeroVector;
+};
+
+UCLASS(Config=Game)
+class FIRSTPERSONTEST_API UAI_Pathfinding : public UTickableWorldSubsystem
 {
 	GENERATED_BODY()
 
 public:
 
-	// Calls the populate nodes function when the world has loaded.
-	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	// Sets up the path cache and the path buffers.
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// Cancels every path request that is still running.
+	virtual void Deinitialize() override;
+
+	// Applies the nodes that were added or removed during the frame, then hands finished asynchronous path requests back to whoever asked for them.
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Adds a navigation node actor to the graph. Nodes call this when they begin play, so nodes that are spawned or streamed in later are found too.
+	// The graph is updated at the start of the next tick, so many nodes arriving on the same frame only update it once.
+	void RegisterNode(AAI_Navigation* Node);
+
+	// Removes a navigation node actor from the graph. Nodes call this when they end play.
+	void UnregisterNode(AAI_Navigation* Node);
+
+	// Adds every node of a navigation graph actor to the graph. Graph actors call this when they begin play.
+	void RegisterGraph(const AAI_NavigationGraph* Graph);
+
+	// Removes every node of a navigation graph actor from the graph. Graph actors call this when they end play.
+	void UnregisterGraph(const AAI_NavigationGraph* Graph);
 
 	// Gets a random path that could be taken by the AI from a staring location.
-	TArray<FVector> GetRandomPath(const FVector& StartLocation);
+	TArray<FVector> GetRandomPath(const FVector& StartLocation, EAI_SearchMode Mode = EAI_SearchMode::Default);
 
 	// Gets a shortest path to reach a certain target.
-	TArray<FVector> GetPath(const FVector& StartLocation, const FVector& TargetLocation);
+	TArray<FVector> GetPath(const FVector& StartLocation, const FVector& TargetLocation, EAI_SearchMode Mode = EAI_SearchMode::Default);
+
+	// Gets a shortest path for every query in one call. OutPaths points at the path to fill for each query, so it must have the same number of entries as Queries.
+	// The closest nodes of every query are found together, and queries heading to the same node share one backwards search from it.
+	void GetPaths(TArrayView<const FAI_PathQuery> Queries, TArrayView<FAI_CompactPath* const> OutPaths, EAI_SearchMode Mode = EAI_SearchMode::Default);
+
+	// Checks if there is a path from the closest node of one location to the closest node of another.
+	bool AreConnected(const FVector& StartLocation, const FVector& TargetLocation);
+
+	// Copies the nodes of a path, from the end node back to the start node, into a compact path. The path keeps its buffer between paths.
+	// If path smoothing is on, the lines between nearby nodes of the path are traced in the background.
+	void AssignPath(FAI_CompactPath& Path, const TArray<int32>& InPathNodes, uint32 InGraphVersion);
+
+	// Gets the location of the next node of a compact path. Returns false if the path is empty, its next node has been removed,
+	// or the nodes have been numbered again since the path was found.
+	bool GetPathWaypoint(const FAI_CompactPath& Path, FVector& OutLocation) const;
+
+	// Moves a compact path on to its next node once the current one has been reached.
+	// If path smoothing is on, the nodes that can be walked past in a straight line from the reached node are skipped.
+	void AdvancePath(FAI_CompactPath& Path);
+
+	// Gets the location of the node a compact path leads to, including the part that was cut off if the path was truncated.
+	bool GetPathGoal(const FAI_CompactPath& Path, FVector& OutLocation) const;
+
+	// Gives the buffer of a compact path back to the subsystem once the path is no longer needed.
+	void ReleasePath(FAI_CompactPath& Path);
+
+	// Forgets the nodes of a compact path and stops counting its agent on the edge it was walking along. The buffer is kept.
+	void ClearPath(FAI_CompactPath& Path);
+
+	// Gets a shortest path to reach a target actor that many enemies may be chasing, such as a player.
+	// The path is read from a flow field that is shared by everyone chasing the same target. The path is cleared if the target cannot be reached.
+	void GetChasePath(const FVector& StartLocation, const AActor* Target, FAI_CompactPath& OutPath);
+
+	// Gets the location of the next node to walk to from a location to reach a target actor.
+	// CurrentPath is the path the agent is following, if it has one, so the edge it is walking along is not held against it.
+	// Returns false if the target cannot be reached.
+	bool GetChaseWaypoint(const FVector& Location, const AActor* Target, FVector& OutWaypoint, const FAI_CompactPath* CurrentPath = nullptr);
+
+	// Checks if chase paths are read from shared flow fields. If not, chasing enemies should ask for their own paths.
+	bool UsesChaseFlowFields() const { return bUseChaseFlowFields; }
+
+	// Checks if chasing enemies should keep an incremental search towards their target when flow fields are turned off.
+	bool UsesIncrementalChaseSearch() const { return bUseIncrementalChaseSearch; }
+
+	// Makes an incremental search for an enemy to chase a target with. It has to be released once the enemy stops chasing.
+	FAI_IncrementalSearchHandle CreateChaseSearch();
+
+	// Forgets an incremental search and clears its handle.
+	void ReleaseChaseSearch(FAI_IncrementalSearchHandle& Handle);
+
+	// Brings an incremental search towards a target up to date. Only the part of the search that the target's move affected is redone.
+	// A new path is written if the target has moved to a different node or bForceNewPath is set. Returns true if the path was written.
+	bool UpdateChaseSearch(FAI_IncrementalSearchHandle Handle, const FVector& Location, const AActor* Target, bool bForceNewPath, FAI_CompactPath& OutPath);
+
+	// Checks if the graph is big enough to be split into clusters. If so, long paths should be found with the hierarchical functions.
+	bool UsesHierarchicalPaths() const;
+
+	// Gets a random path at the cluster level from a starting location. It is turned into node locations with RefineHierarchicalPath.
+	bool GetRandomHierarchicalPath(const FVector& StartLocation, FAI_HierarchicalPath& OutPath);
+
+	// Gets a shortest path at the cluster level to reach a certain target.
+	bool GetHierarchicalPath(const FVector& StartLocation, const FVector& TargetLocation, FAI_HierarchicalPath& OutPath);
+
+	// Turns the next cluster of a hierarchical path into nodes to walk to. Returns false once the whole path has been refined.
+	bool RefineHierarchicalPath(FAI_HierarchicalPath& Path, FAI_CompactPath& OutPath);
+
+	// Starts searching for a random path from a starting location on a worker thread.
+	// CurrentPath is the path the agent is following, if it has one, so the edge it is walking along is not held against it.
+	FAI_PathRequestHandle RequestRandomPath(const FVector& StartLocation, FAI_OnPathRequestComplete OnComplete = FAI_OnPathRequestComplete(), EAI_SearchMode Mode = EAI_SearchMode::Default,
+		EAI_PathRequestPriority Priority = EAI_PathRequestPriority::Normal, const FAI_CompactPath* CurrentPath = nullptr);
+
+	// Starts searching for a shortest path to reach a certain target on a worker thread.
+	// The callback is called on the game thread once the path is found. Without a callback, the result has to be polled.
+	// When searches are time sliced, they run on the game thread instead, and high priority requests are searched first.
+	// CurrentPath is the path the agent is following, if it has one, so the edge it is walking along is not held against it.
+	FAI_PathRequestHandle RequestPath(const FVector& StartLocation, const FVector& TargetLocation, FAI_OnPathRequestComplete OnComplete = FAI_OnPathRequestComplete(), EAI_SearchMode Mode = EAI_SearchMode::Default,
+		EAI_PathRequestPriority Priority = EAI_PathRequestPriority::Normal, const FAI_CompactPath* CurrentPath = nullptr);
+
+	// Checks if a path request has finished. If it has, the path is copied out and the handle can no longer be used.
+	EAI_PathRequestStatus PollPathRequest(FAI_PathRequestHandle Handle, FAI_CompactPath& OutPath);
+
+	// Stops a path request whose path is no longer needed.
+	void CancelPathRequest(FAI_PathRequestHandle Handle);
+
+	// Gets the hit and miss counters of the path cache.
+	FAI_PathCacheStats GetPathCacheStats() const;
+
+	// Sets the hit and miss counters of the path cache back to zero.
+	void ResetPathCacheStats();
+
+	// Gets the hit, miss and eviction counters of the cache of which nodes can see each other.
+	FAI_VisibilityCacheStats GetVisibilityCacheStats() const;
+
+	// Sets the counters of the visibility cache back to zero.
+	void ResetVisibilityCacheStats();
+
+	// Gets how many A* searches have run, on the game thread and on worker threads, and how many nodes they expanded.
+	FAI_SearchStats GetSearchStats() const;
+
+	// Sets the search counters back to zero.
+	void ResetSearchStats();
+
+	// Times the same random node pairs with the unidirectional and bidirectional searches and logs how they compare.
+	void BenchmarkSearchModes(int32 NumQueries);
+
+	// Writes the baked graph and the tables built from it to the cooked graph file of the current map.
+	// The next time the same nodes are loaded, the graph is read from the file instead of being built.
+	bool SaveCookedGraph();
 
 protected:
 
-	// A list of all Navigation Nodes
-	TArray<AAI_Navigation*> NavigationNodes;
+	// How many paths between pairs of nodes are remembered. Zero turns the path cache off.
+	UPROPERTY(Config)
+	int32 PathCacheCapacity = 256;
+
+	// Whether a table of the next node between every pair of nodes is built when the world begins play.
+	// Paths are then read from the table instead of being searched.
+	UPROPERTY(Config)
+	bool bUseNextHopTable = true;
+
+	// The most memory the next node table may take, in kilobytes. Graphs that need a bigger table are searched with A* instead.
+	UPROPERTY(Config)
+	int32 NextHopTableBudgetKB = 8192;
+
+	// Whether every enemy chasing the same target shares a flow field towards it instead of searching its own path.
+	UPROPERTY(Config)
+	bool bUseChaseFlowFields = true;
+
+	// Whether enemies chasing without flow fields keep an incremental search towards their target instead of asking for new paths.
+	UPROPERTY(Config)
+	bool bUseIncrementalChaseSearch = true;
+
+	// The most strongly connected components a graph may have for a table of which components can reach which to be built.
+	// The table takes one bit for every pair of components. Without it, one-way edges between components are not ruled out before a search.
+	UPROPERTY(Config)
+	int32 MaxReachabilityTableComponents = 4096;
+
+	// Whether path requests are searched on the game thread a slice at a time within a budget each frame, instead of on worker threads.
+	// Time sliced searches always run from one end.
+	UPROPERTY(Config)
+	bool bTimeSliceSearches = false;
+
+	// How long time sliced searches may run for each frame, in microseconds. It is shared by every request that is waiting.
+	UPROPERTY(Config)
+	float SearchBudgetMicroseconds = 1000.0f;
+
+	// How many nodes a time sliced search expands between checks of the frame budget.
+	UPROPERTY(Config)
+	int32 ExpansionsPerSlice = 128;
+
+	// Whether searches that do not ask for a mode run from both ends rather than just from the start.
+	UPROPERTY(Config)
+	bool bPreferBidirectionalSearch = true;
+
+	// How many landmark nodes are picked for the A* heuristic when the world begins play. Zero turns landmarks off.
+	// Each landmark stores two distances for every node, and is only used for graphs without a next node table.
+	UPROPERTY(Config)
+	int32 NumLandmarks = 8;
+
+	// Whether large graphs are split into clusters so that long paths are searched at the cluster level first.
+	UPROPERTY(Config)
+	bool bUseHierarchicalPathfinding = true;
+
+	// The smallest number of nodes a graph needs before it is split into clusters.
+	UPROPERTY(Config)
+	int32 HierarchicalMinNodes = 1000;
+
+	// The width and depth of each cluster, in centimetres.
+	UPROPERTY(Config)
+	float HierarchicalClusterSize = 3000.0f;
+
+	// How many queries of a GetPaths batch need to share a goal before they are answered from a flow field towards it rather than searched one by one.
+	UPROPERTY(Config)
+	int32 BatchFlowFieldMinQueries = 4;
+
+	// How many nodes each enemy's path buffer holds. Longer paths are cut off and continued once the enemy reaches the end of the first part.
+	UPROPERTY(Config)
+	int32 PathBufferCapacity = 128;
+
+	// Whether enemies skip the nodes of their path that they can walk past in a straight line.
+	UPROPERTY(Config)
+	bool bSmoothPaths = true;
+
+	// How many nodes ahead of the node an enemy has reached are checked for a straight line.
+	UPROPERTY(Config)
+	int32 SmoothingLookahead = 4;
+
+	// How high above the nodes the lines between them are traced, in centimetres, so that bumps in the floor do not block them.
+	UPROPERTY(Config)
+	float VisibilityTraceHeight = 50.0f;
+
+	// How many pairs of nodes are remembered as being able to see each other or not.
+	UPROPERTY(Config)
+	int32 VisibilityCacheCapacity = 65536;
+
+	// Whether the graph is read from the map's cooked graph file when the file was cooked from the same nodes.
+	UPROPERTY(Config)
+	bool bLoadCookedGraph = true;
+
+	// How much longer an edge counts as for each enemy walking along it, as a fraction of its length. Zero turns congestion off.
+	// Enemies then spread over other routes instead of all taking the same shortest one.
+	UPROPERTY(Config)
+	float CongestionWeight = 0.5f;
+
+	// How much more the shortest path must cost with the enemies on it than without them, as a fraction of its length,
+	// before a search looks for a way around them. No way around can save more than that, so a small detour is not worth a search.
+	UPROPERTY(Config)
+	float CongestionReplanMargin = 0.25f;
+
+	// The shortest straight line distance from the start of a free roam path that its destination is preferred to be at, in centimetres.
+	UPROPERTY(Config)
+	float DestinationMinDistance = 1000.0f;
+
+	// The longest straight line distance from the start of a free roam path that its destination is preferred to be at, in centimetres.
+	UPROPERTY(Config)
+	float DestinationMaxDistance = 6000.0f;
+
+	// How likely a free roam destination outside the preferred distances is to be kept, rather than drawn again.
+	UPROPERTY(Config)
+	float OutOfRangeDestinationChance = 0.1f;
+
+	// How long a node is held back after being picked as a free roam destination, in seconds, so patrols cover more of the map.
+	UPROPERTY(Config)
+	float DestinationRecencySeconds = 30.0f;
+
+	// How likely a node that was just picked is to be turned down when it is drawn again. It fades to zero over DestinationRecencySeconds.
+	UPROPERTY(Config)
+	float DestinationRecencyPenalty = 0.9f;
+
+	// How many times a free roam destination is drawn before the best of the nodes that were turned down is used anyway.
+	UPROPERTY(Config)
+	int32 DestinationSampleAttempts = 16;
+
+	// The location of every node, by node index. Removed nodes keep their index until more than half of the nodes are removed.
+	TArray<FVector> RegisteredLocations;
+
+	// The indices of the nodes each node is connected to
+	TArray<TArray<int32>> RegisteredAdjacency;
+
+	// How likely each node is to be picked as a free roam destination
+	TArray<float> RegisteredDestinationWeights;
+
+	// The navigation node actor each node came from, or null for the nodes of navigation graph actors.
+	// The actors are held weakly, so a node actor destroyed without ending play is never mistaken for a live one.
+	TArray<TWeakObjectPtr<AAI_Navigation>> NodeActors;
+
+	// Which node indices belong to removed nodes
+	TBitArray<> RemovedNodes;
+
+	// How many node indices belong to removed nodes
+	int32 NumRemovedNodes = 0;
+
+	// The index in the graph of each registered navigation node actor. The keys stay unique even if an actor's memory is reused.
+	TMap<TObjectKey<AAI_Navigation>, int32> NodeIndices;
+
+	// The nodes linked to navigation node actors that have not registered yet, by the actor they are linked to.
+	// The links are added once that actor registers, so nodes can stream in in any order.
+	TMultiMap<TObjectKey<AAI_Navigation>, int32> PendingLinks;
+
+	// The first node index and the number of nodes of each registered navigation graph actor
+	TMap<const AAI_NavigationGraph*, TPair<int32, int32>> GraphNodeRanges;
+
+	// Whether nodes or links have been added since the graph was last updated
+	bool bNodesAdded = false;
+
+	// Whether nodes have been removed since the graph was last updated
+	bool bNodesRemoved = false;
+
+	// Whether the map's cooked graph file has been looked for, which only happens on the first update
+	bool bCookedGraphChecked = false;
+
+	// The baked copy of the navigation graph that every path query runs against, with the tables built from it.
+	// It is never changed once built, and worker searches hold their own reference to it, so they can keep searching an old copy while a new one replaces it.
+	// The reference itself is only read and replaced on the game thread.
+	FAI_NavGraphRef NavGraph = MakeShared<const FAI_NavGraph, ESPMode::ThreadSafe>();
+
+	// How many enemies are walking along each edge of the newest graph, or null if congestion is turned off.
+	// A new one is made for every graph version, and paths counted on an older one are simply not counted anymore.
+	TSharedPtr<FAI_EdgeOccupancy, ESPMode::ThreadSafe> EdgeOccupancy;
+
+	// Counts how many times the graph has been updated. Each new graph snapshot gets the next version.
+	uint32 GraphVersion = 0;
+
+	// The search state that is reused by every path search on the game thread
+	FAI_SearchContext SearchContext;
+
+	// The search state of the backward half of bidirectional searches on the game thread
+	FAI_SearchContext BackwardSearchContext;
+
+	// The clusters of large graphs and the abstract graph between them
+	FAI_HierarchicalGraph HierarchicalGraph;
+
+	// Draws free roam destinations by their weights, and remembers which were picked recently
+	FAI_DestinationSampler DestinationSampler;
+
+	// A flow field towards each target that is being chased. It is rebuilt only when the target's closest node changes.
+	TMap<TWeakObjectPtr<const AActor>, FAI_FlowField> FlowFields;
+
+	// The flow field used by the last GetPaths batch, kept in case the next batch heads to the same goal
+	FAI_FlowField BatchFlowField;
+
+	// The incremental searches of the enemies that are chasing a target, by handle id
+	TMap<uint32, TUniquePtr<FAI_IncrementalSearch>> ChaseSearches;
+
+	// The id the next incremental search will be given
+	uint32 NextChaseSearchId = 1;
+
+	// The path requests that are searched on worker threads
+	TSharedRef<FAI_PathRequestQueue, ESPMode::ThreadSafe> PathRequests = MakeShared<FAI_PathRequestQueue, ESPMode::ThreadSafe>();
+
+	// The most recently used paths, so enemies asking for the same path do not search it again
+	FAI_PathCache PathCache;
+
+	// How many A* searches have run on the game thread and how many nodes they expanded
+	FAI_SearchStats SearchStats;
+
+	// The buffers the paths of every enemy are stored in
+	FAI_PathBufferPool PathBuffers;
+
+	// Which pairs of nodes have a clear straight line between them, used to smooth paths
+	FAI_VisibilityCache VisibilityCache;
+
+	// The nodes of the last path found on the game thread, reused so that finding a path does not allocate
+	TArray<int32> PathNodes;
 
 private:
 
-	// Adds all nodes in the world to the Navigation Node list
-	void PopulateNodes();
+	// Bakes the nodes added and removed since the last update into a new graph snapshot, and brings everything built from the graph up to date.
+	void UpdateGraph();
+
+	// Takes a node out of the graph. Its index is kept, without any links, until the nodes are numbered again.
+	void RemoveNode(int32 Node);
+
+	// Drops the links to the nodes removed since the last update. Links between node actors are kept as pending links.
+	void RemoveLinksToRemovedNodes();
+
+	// Numbers the nodes again without the removed ones, keeping their order.
+	void CompactNodes();
+
+	// Gets where the cooked graph file of the current map is kept.
+	FString GetCookedGraphFilename() const;
+
+	// Gets a hash of the locations and links of every registered node, which a cooked graph file has to match to be used.
+	uint64 GetRegisteredNodesHash() const;
+
+	// Gets the index of a random navigation node in the world
+	int32 GetRandomNode();
+
+	// Gets the index of a random navigation node that can be reached from a node, for a free roam path.
+	// Nodes are drawn by their destination weights, and kept or drawn again based on their distance and when they were last picked.
+	// Returns INDEX_NONE if no other node with weight can be reached.
+	int32 GetRandomReachableNode(int32 StartNode);
+
+	// Gets the index of the closest navigation node from a target
+	int32 GetClosestNode(const FVector& TargetLocation);
+
+	// Gets the index of the furthest navigation node from a target
+	int32 GetFurthestNode(const FVector& TargetLocation);
+
+	// Gets the index of the closest navigation node for each of the target locations
+	void GetClosestNodes(TArrayView<const FVector> TargetLocations, TArray<int32>& OutNodes);
+
+	// Gets the nodes of a path from a start navigation node to the ending navigation node.
+	// IgnoredEdge is the edge the enemy asking for the path is walking along, which does not count as congested by that enemy.
+	bool GetPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, TArray<int32>& OutNodes, int32 IgnoredEdge = INDEX_NONE);
+
+	// Runs a search between two nodes on the game thread and gets the nodes of the path
+	bool SearchPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, TArray<int32>& OutNodes);
+
+	// Gets the edge counters to go around instead of following a shortest path, or null if the shortest path should be followed.
+	// Every way of getting a path asks this, so they all agree on when to go around traffic. IgnoredEdge is the edge the enemy asking is walking along.
+	TSharedPtr<const FAI_EdgeOccupancy, ESPMode::ThreadSafe> GetPathCongestion(const TArray<int32>& ShortestPath, int32 IgnoredEdge) const;
+
+	// Gets the edge an agent is counted on in the newest edge counters, or INDEX_NONE
+	int32 GetOccupiedEdge(const FAI_CompactPath* Path) const;
+
+	// Gets the nodes of a path from a flow field, going around traffic if GetPathCongestion says the shortest path is too busy
+	void GetFlowFieldPath(const FAI_FlowField& FlowField, int32 StartNode, int32 IgnoredEdge, TArray<int32>& OutNodes) const;
+
+	// Counts the agent following a path onto the edge between two nodes, if they are linked
+	void EnterEdge(FAI_CompactPath& Path, int32 FromNode, int32 ToNode) const;
+
+	// Stops counting the agent following a path on the edge it was walking along
+	void LeaveEdge(FAI_CompactPath& Path) const;
+
+	// Looks up the location of every node of a path
+	void GetNodeLocations(const TArray<int32>& Nodes, TArray<FVector>& OutLocations) const;
+
+	// Turns the default search mode into the mode the subsystem prefers
+	EAI_SearchMode ResolveSearchMode(EAI_SearchMode Mode) const;
 
-	// Gets a random navigation node in the world
-	AAI_Navigation* GetRandomNode();
+	// Gets the flow field towards a target, rebuilding it if the target has moved to a different closest node
+	const FAI_FlowField* UpdateFlowField(const AActor* Target);
 
-	// Gets the closes navigation node from a target
-	AAI_Navigation* GetClosestNode(const FVector& TargetLocation);
+	// Starts traces between the nodes of a path that AdvancePath may want to skip between, unless they are already known
+	void RequestPathVisibility(const FAI_CompactPath& Path);
 
-	// Gets the furthest navigation node from a target
-	AAI_Navigation* GetFurthestNode(const FVector& TargetLocation);
+	// Stores the result of a trace between two nodes
+	void OnVisibilityTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint64 Key, uint32 TraceLayoutVersion);
 
-	// Gets a path from a start navigation node to the ending navigation node
-	TArray<FVector> GetPath(AAI_Navigation* StartNode, AAI_Navigation* EndNode);
+	// Gets a flow field towards a goal node for a GetPaths batch, reusing the field of a chased target if one already leads there
+	const FAI_FlowField* GetBatchFlowField(int32 GoalNode);
 
-	// Reconstructs a path 
-	static TArray<FVector> ReconstructPath(const TMap<AAI_Navigation*, AAI_Navigation*>& CameFromMap, AAI_Navigation* EndNode);
+	// Starts searching for a path from a start navigation node to the ending navigation node, unless it is already cached
+	FAI_PathRequestHandle RequestPath(int32 StartNode, int32 EndNode, EAI_SearchMode Mode, EAI_PathRequestPriority Priority, int32 IgnoredEdge, FAI_OnPathRequestComplete OnComplete);
 	
 };
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_SpatialIndex.h"
+#include "AI_NavGraph.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+// The largest number of nodes a leaf box holds. Small leaves are scanned directly, which is faster than splitting them further.
+static constexpr int32 KdTreeLeafSize = 8;
+
+// The smallest number of locations that are worth spreading over worker threads in a batch query.
+static constexpr int32 KdTreeParallelBatchSize = 64;
+
+// Splits the nodes into boxes and then copies their positions into tree order so that leaves are scanned from contiguous memory.
+// Removed nodes are left out, so they are never found as the closest or furthest node.
+void FAI_NodeKdTree::Build(const FAI_NavGraph& Graph)
+{
+	Empty();
+
+	NodeIndices.Reserve(Graph.NumNodes());
+	for (int32 Node = 0; Node < Graph.NumNodes(); Node++)
+	{
+		if (!Graph.IsNodeRemoved(Node))
+		{
+			NodeIndices.Add(Node);
+		}
+	}
+
+	const int32 NodeCount = NodeIndices.Num();
+	if (NodeCount == 0)
+	{
+		return;
+	}
+
+	// A balanced tree has about twice as many boxes as it has leaves.
+	Boxes.Reserve(2 * NodeCount / KdTreeLeafSize + 1);
+	BuildBox(Graph, 0, NodeCount);
+
+	PositionsX.SetNumUninitialized(NodeCount);
+	PositionsY.SetNumUninitialized(NodeCount);
+	PositionsZ.SetNumUninitialized(NodeCount);
+	for (int32 Entry = 0; Entry < NodeCount; Entry++)
+	{
+		PositionsX[Entry] = Graph.PositionsX[NodeIndices[Entry]];
+		PositionsY[Entry] = Graph.PositionsY[NodeIndices[Entry]];
+		PositionsZ[Entry] = Graph.PositionsZ[NodeIndices[Entry]];
+	}
+}
+
+void FAI_NodeKdTree::Empty()
+{
+	Boxes.Reset();
+	NodeIndices.Reset();
+	PositionsX.Reset();
+	PositionsY.Reset();
+	PositionsZ.Reset();
+}
+
+// Gets the bounds of a range of nodes, then splits it at the median of its longest axis.
+int32 FAI_NodeKdTree::BuildBox(const FAI_NavGraph& Graph, int32 Begin, int32 End)
+{
+	const int32 BoxIndex = Boxes.AddDefaulted();
+
+	FVector3f Min(UE_MAX_FLT);
+	FVector3f Max(-UE_MAX_FLT);
+	for (int32 Entry = Begin; Entry < End; Entry++)
+	{
+		const int32 Node = NodeIndices[Entry];
+		const FVector3f Position(Graph.PositionsX[Node], Graph.PositionsY[Node], Graph.PositionsZ[Node]);
+		Min = FVector3f::Min(Min, Position);
+		Max = FVector3f::Max(Max, Position);
+	}
+
+	Boxes[BoxIndex].Min = Min;
+	Boxes[BoxIndex].Max = Max;
+	Boxes[BoxIndex].Begin = Begin;
+	Boxes[BoxIndex].End = End;
+
+	// If the box is small enough, then keep it as a leaf.
+	if (End - Begin <= KdTreeLeafSize)
+	{
+		return BoxIndex;
+	}
+
+	// Split along the axis where the nodes are spread out the most.
+	const FVector3f Extent = Max - Min;
+	const TArray<float>* SplitPositions = &Graph.PositionsX;
+	if (Extent.Y > Extent.X && Extent.Y >= Extent.Z)
+	{
+		SplitPositions = &Graph.PositionsY;
+	}
+	else if (Extent.Z > Extent.X && Extent.Z > Extent.Y)
+	{
+		SplitPositions = &Graph.PositionsZ;
+	}
+
+	Algo::Sort(MakeArrayView(NodeIndices.GetData() + Begin, End - Begin), [SplitPositions](int32 A, int32 B)
+	{
+		return (*SplitPositions)[A] < (*SplitPositions)[B];
+	});
+
+	const int32 Middle = Begin + (End - Begin) / 2;
+	const int32 LeftChild = BuildBox(Graph, Begin, Middle);
+	const int32 RightChild = BuildBox(Graph, Middle, End);
+
+	// The boxes array may have grown while building the children, so the box is looked up again.
+	Boxes[BoxIndex].Children[0] = LeftChild;
+	Boxes[BoxIndex].Children[1] = RightChild;
+
+	return BoxIndex;
+}
+
+// Get the closest navigation node from a location
+int32 FAI_NodeKdTree::FindClosestNode(const FVector& Location) const
+{
+	if (IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	int32 BestEntry = INDEX_NONE;
+	float BestDistanceSquared = UE_MAX_FLT;
+	SearchClosest(0, FVector3f(Location), BestEntry, BestDistanceSquared);
+
+	// No entry beats the starting distance if the location is not a number.
+	return BestEntry != INDEX_NONE ? NodeIndices[BestEntry] : INDEX_NONE;
+}
+
+// Get the furthest navigation node from a location
+int32 FAI_NodeKdTree::FindFurthestNode(const FVector& Location) const
+{
+	if (IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	int32 BestEntry = INDEX_NONE;
+	float BestDistanceSquared = -1.0f;
+	SearchFurthest(0, FVector3f(Location), BestEntry, BestDistanceSquared);
+
+	// No entry beats the starting distance if the location is not a number.
+	return BestEntry != INDEX_NONE ? NodeIndices[BestEntry] : INDEX_NONE;
+}
+
+// Every query only reads the tree, so large batches are spread over worker threads.
+void FAI_NodeKdTree::FindClosestNodes(TArrayView<const FVector> Locations, TArrayView<int32> OutNodes) const
+{
+	check(Locations.Num() == OutNodes.Num());
+
+	const EParallelForFlags Flags = Locations.Num() < KdTreeParallelBatchSize ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+	ParallelFor(Locations.Num(), [this, Locations, OutNodes](int32 Index)
+	{
+		OutNodes[Index] = FindClosestNode(Locations[Index]);
+	}, Flags);
+}
+
+// Leaves are scanned directly. Other boxes visit the nearer child first, so the further child can often be skipped.
+void FAI_NodeKdTree::SearchClosest(int32 BoxIndex, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const
+{
+	const FTreeBox& Box = Boxes[BoxIndex];
+
+	if (Box.Children[0] == INDEX_NONE)
+	{
+		ScanLeafClosest(Box, Location, BestEntry, BestDistanceSquared);
+		return;
+	}
+
+	const float LeftDistance = GetMinDistanceSquared(Boxes[Box.Children[0]], Location);
+	const float RightDistance = GetMinDistanceSquared(Boxes[Box.Children[1]], Location);
+	const bool bLeftFirst = LeftDistance <= RightDistance;
+
+	const int32 NearChild = bLeftFirst ? Box.Children[0] : Box.Children[1];
+	const int32 FarChild = bLeftFirst ? Box.Children[1] : Box.Children[0];
+	const float NearDistance = bLeftFirst ? LeftDistance : RightDistance;
+	const float FarDistance = bLeftFirst ? RightDistance : LeftDistance;
+
+	if (NearDistance < BestDistanceSquared)
+	{
+		SearchClosest(NearChild, Location, BestEntry, BestDistanceSquared);
+	}
+	if (FarDistance < BestDistanceSquared)
+	{
+		SearchClosest(FarChild, Location, BestEntry, BestDistanceSquared);
+	}
+}
+
+// The positions are stored one axis after another, so four entries are loaded into a vector register per axis.
+// The last entries of a leaf that do not fill a register are checked one at a time.
+void FAI_NodeKdTree::ScanLeafClosest(const FTreeBox& Box, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const
+{
+	const VectorRegister4Float LocationX = VectorSetFloat1(Location.X);
+	const VectorRegister4Float LocationY = VectorSetFloat1(Location.Y);
+	const VectorRegister4Float LocationZ = VectorSetFloat1(Location.Z);
+
+	int32 Entry = Box.Begin;
+	for (; Entry + 4 <= Box.End; Entry += 4)
+	{
+		const VectorRegister4Float DeltaX = VectorSubtract(VectorLoad(PositionsX.GetData() + Entry), LocationX);
+		const VectorRegister4Float DeltaY = VectorSubtract(VectorLoad(PositionsY.GetData() + Entry), LocationY);
+		const VectorRegister4Float DeltaZ = VectorSubtract(VectorLoad(PositionsZ.GetData() + Entry), LocationZ);
+		const VectorRegister4Float DistancesSquared = VectorMultiplyAdd(DeltaX, DeltaX, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaZ, DeltaZ)));
+
+		float Distances[4];
+		VectorStore(DistancesSquared, Distances);
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			if (Distances[Lane] < BestDistanceSquared)
+			{
+				BestDistanceSquared = Distances[Lane];
+				BestEntry = Entry + Lane;
+			}
+		}
+	}
+
+	for (; Entry < Box.End; Entry++)
+	{
+		const float DistanceSquared = GetDistanceSquared(Entry, Location);
+		if (DistanceSquared < BestDistanceSquared)
+		{
+			BestDistanceSquared = DistanceSquared;
+			BestEntry = Entry;
+		}
+	}
+}
+
+// The same as the closest search, but boxes are skipped when even their furthest corner is nearer than the best node.
+void FAI_NodeKdTree::SearchFurthest(int32 BoxIndex, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const
+{
+	const FTreeBox& Box = Boxes[BoxIndex];
+
+	if (Box.Children[0] == INDEX_NONE)
+	{
+		for (int32 Entry = Box.Begin; Entry < Box.End; Entry++)
+		{
+			const float DistanceSquared = GetDistanceSquared(Entry, Location);
+			if (DistanceSquared > BestDistanceSquared)
+			{
+				BestDistanceSquared = DistanceSquared;
+				BestEntry = Entry;
+			}
+		}
+		return;
+	}
+
+	const float LeftDistance = GetMaxDistanceSquared(Boxes[Box.Children[0]], Location);
+	const float RightDistance = GetMaxDistanceSquared(Boxes[Box.Children[1]], Location);
+	const bool bLeftFirst = LeftDistance >= RightDistance;
+
+	const int32 FarChild = bLeftFirst ? Box.Children[0] : Box.Children[1];
+	const int32 NearChild = bLeftFirst ? Box.Children[1] : Box.Children[0];
+	const float FarDistance = bLeftFirst ? LeftDistance : RightDistance;
+	const float NearDistance = bLeftFirst ? RightDistance : LeftDistance;
+
+	if (FarDistance > BestDistanceSquared)
+	{
+		SearchFurthest(FarChild, Location, BestEntry, BestDistanceSquared);
+	}
+	if (NearDistance > BestDistanceSquared)
+	{
+		SearchFurthest(NearChild, Location, BestEntry, BestDistanceSquared);
+	}
+}
+
+float FAI_NodeKdTree::GetMinDistanceSquared(const FTreeBox& Box, const FVector3f& Location)
+{
+	const FVector3f Closest = FVector3f::Min(FVector3f::Max(Location, Box.Min), Box.Max);
+	return FVector3f::DistSquared(Location, Closest);
+}
+
+float FAI_NodeKdTree::GetMaxDistanceSquared(const FTreeBox& Box, const FVector3f& Location)
+{
+	const float DeltaX = FMath::Max(FMath::Abs(Location.X - Box.Min.X), FMath::Abs(Location.X - Box.Max.X));
+	const float DeltaY = FMath::Max(FMath::Abs(Location.Y - Box.Min.Y), FMath::Abs(Location.Y - Box.Max.Y));
+	const float DeltaZ = FMath::Max(FMath::Abs(Location.Z - Box.Min.Z), FMath::Abs(Location.Z - Box.Max.Z));
+	return DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+}
+
+float FAI_NodeKdTree::GetDistanceSquared(int32 Entry, const FVector3f& Location) const
+{
+	const float DeltaX = PositionsX[Entry] - Location.X;
+	const float DeltaY = PositionsY[Entry] - Location.Y;
+	const float DeltaZ = PositionsZ[Entry] - Location.Z;
+	return DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+}
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAI_NavGraph;
+
+// A k-d tree over the navigation node positions.
+// It answers closest and furthest node queries by skipping whole boxes of nodes that cannot beat the best node found so far.
+class FIRSTPERSONTEST_API FAI_NodeKdTree
+{
+public:
+
+	// Builds the tree from the node positions of a navigation graph.
+	void Build(const FAI_NavGraph& Graph);
+
+	// Removes every node from the tree.
+	void Empty();
+
+	// Checks if the tree has no nodes.
+	bool IsEmpty() const { return NodeIndices.Num() == 0; }
+
+	// Gets the index of the node closest to a location, or INDEX_NONE if the tree is empty.
+	int32 FindClosestNode(const FVector& Location) const;
+
+	// Gets the index of the node furthest from a location, or INDEX_NONE if the tree is empty.
+	int32 FindFurthestNode(const FVector& Location) const;
+
+	// Finds the closest node for every location. OutNodes must have the same number of entries as Locations.
+	void FindClosestNodes(TArrayView<const FVector> Locations, TArrayView<int32> OutNodes) const;
+
+private:
+
+	// A box of the tree. Leaves point at a range of nodes, the other boxes are split in two along one axis.
+	struct FTreeBox
+	{
+		// The corner of the box with the smallest coordinates.
+		FVector3f Min;
+
+		// The corner of the box with the largest coordinates.
+		FVector3f Max;
+
+		// The first entry of this box in the node arrays.
+		int32 Begin = 0;
+
+		// One past the last entry of this box in the node arrays.
+		int32 End = 0;
+
+		// The child boxes, or INDEX_NONE if this box is a leaf.
+		int32 Children[2] = { INDEX_NONE, INDEX_NONE };
+	};
+
+	// Builds the box for a range of entries and returns its index.
+	int32 BuildBox(const FAI_NavGraph& Graph, int32 Begin, int32 End);
+
+	// Looks for a closer node than the best one so far among the entries of a leaf, four entries at a time.
+	void ScanLeafClosest(const FTreeBox& Box, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const;
+
+	// Looks for a closer node than the best one so far inside a box.
+	void SearchClosest(int32 Box, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const;
+
+	// Looks for a further node than the best one so far inside a box.
+	void SearchFurthest(int32 Box, const FVector3f& Location, int32& BestEntry, float& BestDistanceSquared) const;
+
+	// Gets the squared distance between a location and the nearest point of a box.
+	static float GetMinDistanceSquared(const FTreeBox& Box, const FVector3f& Location);
+
+	// Gets the squared distance between a location and the furthest corner of a box.
+	static float GetMaxDistanceSquared(const FTreeBox& Box, const FVector3f& Location);
+
+	// Gets the squared distance between a location and an entry.
+	float GetDistanceSquared(int32 Entry, const FVector3f& Location) const;
+
+	// The boxes of the tree. The first box is the root.
+	TArray<FTreeBox> Boxes;
+
+	// The navigation node index of each entry, in tree order.
+	TArray<int32> NodeIndices;
+
+	// The X position of each entry, in tree order.
+	TArray<float> PositionsX;
+
+	// The Y position of each entry, in tree order.
+	TArray<float> PositionsY;
+
+	// The Z position of each entry, in tree order.
+	TArray<float> PositionsZ;
+};
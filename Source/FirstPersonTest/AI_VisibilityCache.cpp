@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AI_VisibilityCache.h"
+
+void FAI_VisibilityCache::SetCapacity(int32 NewCapacity)
+{
+	Capacity = FMath::Max(NewCapacity, 0);
+
+	if (Entries.Num() > Capacity)
+	{
+		Empty();
+	}
+}
+
+void FAI_VisibilityCache::Empty()
+{
+	Entries.Reset();
+	EntryLookup.Reset();
+	ClockHand = 0;
+}
+
+void FAI_VisibilityCache::CheckLayoutVersion(uint32 LayoutVersion)
+{
+	if (LayoutVersion != CachedLayoutVersion)
+	{
+		Empty();
+		CachedLayoutVersion = LayoutVersion;
+	}
+}
+
+// A hit marks the pair as used, so the clock hand passes over it once before it can be dropped.
+EAI_Visibility FAI_VisibilityCache::Find(int32 NodeA, int32 NodeB)
+{
+	const int32* Entry = EntryLookup.Find(MakeKey(NodeA, NodeB));
+	if (!Entry || Entries[*Entry].Visibility == EAI_Visibility::Pending)
+	{
+		Misses++;
+		return Entry ? EAI_Visibility::Pending : EAI_Visibility::Unknown;
+	}
+
+	Hits++;
+	Entries[*Entry].bReferenced = true;
+	return Entries[*Entry].Visibility;
+}
+
+// New pairs reuse the entry the clock hand picks once the cache is full.
+bool FAI_VisibilityCache::MarkPending(int32 NodeA, int32 NodeB)
+{
+	const uint64 Key = MakeKey(NodeA, NodeB);
+	if (EntryLookup.Contains(Key))
+	{
+		return false;
+	}
+
+	int32 Entry = INDEX_NONE;
+	if (Entries.Num() < Capacity)
+	{
+		Entry = Entries.AddDefaulted();
+	}
+	else
+	{
+		Entry = FindEvictableEntry();
+		if (Entry == INDEX_NONE)
+		{
+			return false;
+		}
+		EntryLookup.Remove(Entries[Entry].Key);
+		Evictions++;
+	}
+
+	EntryLookup.Add(Key, Entry);
+	Entries[Entry].Key = Key;
+	Entries[Entry].Visibility = EAI_Visibility::Pending;
+	Entries[Entry].bReferenced = false;
+	return true;
+}
+
+// A trace started before the nodes were numbered again may finish afterwards, when its node indices point at other nodes.
+// Pairs being traced are never dropped, so a result whose pair is missing belongs to a cache that has been emptied since.
+void FAI_VisibilityCache::SetResult(uint64 Key, uint32 LayoutVersion, bool bVisible)
+{
+	if (LayoutVersion != CachedLayoutVersion)
+	{
+		return;
+	}
+
+	if (const int32* Entry = EntryLookup.Find(Key))
+	{
+		Entries[*Entry].Visibility = bVisible ? EAI_Visibility::Visible : EAI_Visibility::Blocked;
+		Entries[*Entry].bReferenced = true;
+	}
+}
+
+void FAI_VisibilityCache::GetStats(FAI_VisibilityCacheStats& OutStats) const
+{
+	OutStats.Hits = Hits;
+	OutStats.Misses = Misses;
+	OutStats.Evictions = Evictions;
+	OutStats.NumEntries = Entries.Num();
+	OutStats.Capacity = Capacity;
+}
+
+void FAI_VisibilityCache::ResetStats()
+{
+	Hits = 0;
+	Misses = 0;
+	Evictions = 0;
+}
+
+uint64 FAI_VisibilityCache::MakeKey(int32 NodeA, int32 NodeB)
+{
+	const int32 First = FMath::Min(NodeA, NodeB);
+	const int32 Second = FMath::Max(NodeA, NodeB);
+	return (uint64(uint32(First)) << 32) | uint64(uint32(Second));
+}
+
+// Two turns of the clock are enough: the first clears every used mark it passes, so the second finds an entry unless all of them are being traced.
+int32 FAI_VisibilityCache::FindEvictableEntry()
+{
+	const int32 NumEntries = Entries.Num();
+	for (int32 Step = 0; Step < NumEntries * 2; Step++)
+	{
+		const int32 Entry = ClockHand;
+		ClockHand = (ClockHand + 1) % NumEntries;
+
+		FEntry& Candidate = Entries[Entry];
+		if (Candidate.Visibility == EAI_Visibility::Pending)
+		{
+			continue;
+		}
+		if (Candidate.bReferenced)
+		{
+			Candidate.bReferenced = false;
+			continue;
+		}
+		return Entry;
+	}
+	return INDEX_NONE;
+}
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Whether a straight line between two navigation nodes is clear
+enum class EAI_Visibility : uint8
+{
+	// Nothing is known about the pair yet.
+	Unknown,
+
+	// A trace between the pair has been started and has not finished yet.
+	Pending,
+
+	Visible,
+	Blocked
+};
+
+// The counters of the visibility cache, used to size it for a map
+struct FIRSTPERSONTEST_API FAI_VisibilityCacheStats
+{
+	// How many lookups found a finished trace.
+	int64 Hits = 0;
+
+	// How many lookups found nothing, or a trace that had not finished yet.
+	int64 Misses = 0;
+
+	// How many pairs were dropped to make room for new ones.
+	int64 Evictions = 0;
+
+	// How many pairs are in the cache right now.
+	int32 NumEntries = 0;
+
+	// How many pairs the cache can hold.
+	int32 Capacity = 0;
+};
+
+// Remembers which pairs of navigation nodes can see each other, filled in by traces that finish over the following frames.
+// Pairs are stored once for both directions. A result only depends on where the two nodes are, so the entries are kept while nodes are added
+// and removed, and are only dropped when the nodes are numbered again.
+// Once the cache is full, new pairs take the place of pairs that have not been looked up lately, picked with the clock algorithm.
+class FIRSTPERSONTEST_API FAI_VisibilityCache
+{
+public:
+
+	// Sets how many pairs the cache can hold.
+	void SetCapacity(int32 NewCapacity);
+
+	// Removes every pair from the cache.
+	void Empty();
+
+	// Drops every pair if they belong to a different numbering of the nodes, given by the graph's layout version.
+	void CheckLayoutVersion(uint32 LayoutVersion);
+
+	// Gets what is known about a pair of nodes. Counts a hit or a miss.
+	EAI_Visibility Find(int32 NodeA, int32 NodeB);
+
+	// Marks a pair as waiting on a trace, dropping a pair that has not been looked up lately if the cache is full.
+	// Returns false if the pair is already known or being traced, or if every pair in the cache is still being traced.
+	bool MarkPending(int32 NodeA, int32 NodeB);
+
+	// Stores the result of a trace. Results for an old numbering of the nodes are ignored.
+	void SetResult(uint64 Key, uint32 LayoutVersion, bool bVisible);
+
+	// Gets the number of pairs in the cache, including the ones still being traced.
+	int32 Num() const { return Entries.Num(); }
+
+	// Gets the hit, miss and eviction counters.
+	void GetStats(FAI_VisibilityCacheStats& OutStats) const;
+
+	// Sets the hit, miss and eviction counters back to zero.
+	void ResetStats();
+
+	// Makes the key a pair of nodes is stored under. The smaller node comes first, so both directions share a key.
+	static uint64 MakeKey(int32 NodeA, int32 NodeB);
+
+private:
+
+	// What is known about one pair of nodes.
+	struct FEntry
+	{
+		// The key of the node pair.
+		uint64 Key = 0;
+
+		// What is known about the pair.
+		EAI_Visibility Visibility = EAI_Visibility::Unknown;
+
+		// Whether the pair has been looked up since the clock hand last passed it.
+		bool bReferenced = false;
+	};
+
+	// Moves the clock hand on until it finds a finished pair that has not been looked up since it last passed.
+	// Returns INDEX_NONE if every pair is still being traced.
+	int32 FindEvictableEntry();
+
+	// The pairs in the cache. Entries are reused rather than removed.
+	TArray<FEntry> Entries;
+
+	// The entry of each pair in the cache.
+	TMap<uint64, int32> EntryLookup;
+
+	// The next entry the clock hand looks at when a pair has to be dropped.
+	int32 ClockHand = 0;
+
+	// How many pairs the cache can hold.
+	int32 Capacity = 0;
+
+	// The layout version of the graph the pairs belong to.
+	uint32 CachedLayoutVersion = 0;
+
+	// How many lookups found a finished trace.
+	int64 Hits = 0;
+
+	// How many lookups did not.
+	int64 Misses = 0;
+
+	// How many pairs were dropped to make room for new ones.
+	int64 Evictions = 0;
+};